@@ -0,0 +1,63 @@
+// Minimal consumer for SHM_OUTPUT = 1: maps the mesh placed in shared memory by ./marching
+// build: g++ ./example/shm_consumer.cpp -pthread -lz -lrt -o ./shm_consumer
+// run  : ./shm_consumer [SHM_NAME] [OUTPUT_PLY]
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+#include "../include/shm_mesh.h"
+#include "../include/save_ply.h"
+
+int main(int argc, char* argv[])
+{
+    std::string name = argc > 1 ? argv[1] : "/marching_tetrahedrons_mesh";
+
+    SharedMeshView mesh;
+    if(!open_shared_mesh(name, mesh, 10000))
+    {
+        std::cout << "No ready mesh in shared memory: " << name << std::endl;
+        return 1;
+    }
+
+    std::cout << "Number of vertices: " << mesh.header->num_vertices << std::endl;
+    std::cout << "Number of triangles: " << mesh.header->num_faces << std::endl;
+
+    // Read straight from the mapping, no parsing
+    float min_pt[3] = {0, 0, 0};
+    float max_pt[3] = {0, 0, 0};
+    for(uint64_t v = 0; v < mesh.header->num_vertices; v++)
+        for(int a = 0; a < 3; a++)
+        {
+            float value = mesh.vertices[3 * v + a];
+            min_pt[a] = v == 0 ? value : std::min(min_pt[a], value);
+            max_pt[a] = v == 0 ? value : std::max(max_pt[a], value);
+        }
+    std::cout << "Bounding box: (" << min_pt[0] << ", " << min_pt[1] << ", " << min_pt[2] << ") - ("
+              << max_pt[0] << ", " << max_pt[1] << ", " << max_pt[2] << ")" << std::endl;
+
+    uint64_t num_bad_indices = 0;
+    for(uint64_t i = 0; i < 3 * mesh.header->num_faces; i++)
+        if(mesh.indices[i] >= mesh.header->num_vertices)
+            num_bad_indices++;
+    std::cout << "Out of range indices: " << num_bad_indices << std::endl;
+
+    // Optionally dump to PLY to compare with the file output
+    bool ok = true;
+    if(argc > 2)
+    {
+        IndexedMesh copy;
+        for(uint64_t v = 0; v < mesh.header->num_vertices; v++)
+        {
+            copy.x.push_back(mesh.vertices[3 * v]);
+            copy.y.push_back(mesh.vertices[3 * v + 1]);
+            copy.z.push_back(mesh.vertices[3 * v + 2]);
+        }
+        copy.indices.assign(mesh.indices, mesh.indices + 3 * mesh.header->num_faces);
+        ok = write_to_ply(copy, argv[2]) >= 0;
+        if(!ok)
+            std::cout << "Failed to write: " << argv[2] << std::endl;
+    }
+
+    close_shared_mesh(mesh);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,346 @@
+#ifndef ASYNC_WRITER
+#define ASYNC_WRITER
+
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <sched.h>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#else
+#define HAVE_IO_URING 0
+#endif
+
+#include "include.h"
+#include "parameters.h"
+#include "thread_pool.h"
+
+// ===============================================================
+// Asynchronous file writer
+// Output is gathered into ASYNC_WRITE_BUFFER_SIZE buffers; full buffers are written in the
+// background (io_uring if the kernel allows it, otherwise pwrite on worker threads) while
+// the caller keeps filling the next one. Only waiting for a free buffer blocks the caller.
+class AsyncWriter
+{
+public:
+    ~AsyncWriter() { close(); }
+
+    bool open(const char* path)
+    {
+        fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0)
+            return false;
+
+        buffers.resize(ASYNC_WRITE_BUFFERS);
+        in_flight.assign(ASYNC_WRITE_BUFFERS, false);
+        for(auto &buffer: buffers)
+            buffer.reserve(ASYNC_WRITE_BUFFER_SIZE);
+
+        uses_io_uring = setup_io_uring();
+        if(!uses_io_uring)
+            pool.reset(new ThreadPool(ASYNC_WRITE_BUFFERS));
+        return true;
+    }
+
+    void write(const char* data, size_t size)
+    {
+        while(size > 0)
+        {
+            std::vector<char> &buffer = buffers[current];
+            size_t num_copy = std::min(size, ASYNC_WRITE_BUFFER_SIZE - buffer.size());
+            buffer.insert(buffer.end(), data, data + num_copy);
+            data += num_copy;
+            size -= num_copy;
+
+            if(buffer.size() == ASYNC_WRITE_BUFFER_SIZE)
+                submit_current();
+        }
+    }
+
+    // Formats like std::ostream's default float output ("%g")
+    void write_float(float value)
+    {
+        char text[32];
+        int len = snprintf(text, sizeof(text), "%g", value);
+        write(text, len);
+    }
+
+    void write_int(long long value)
+    {
+        char text[32];
+        int len = snprintf(text, sizeof(text), "%lld", value);
+        write(text, len);
+    }
+
+    void write(const char* text) { write(text, strlen(text)); }
+
+    // Flush, wait for every write and close the file; false if any write failed
+    bool close()
+    {
+        if(fd < 0)
+            return !failed;
+
+        if(!buffers[current].empty())
+            submit_current();
+        for(int b = 0; b < (int)buffers.size(); b++)
+            wait_for_buffer(b);
+
+        if(uses_io_uring)
+            teardown_io_uring();
+        pool.reset();
+
+        if(::close(fd) != 0)
+            failed = true;
+        fd = -1;
+        return !failed;
+    }
+
+    bool uses_io_uring = false;
+    double blocked_ms = 0;
+    size_t bytes_written = 0;
+
+private:
+    void submit_current()
+    {
+        int b = current;
+        off_t offset = file_offset;
+        file_offset += buffers[b].size();
+        bytes_written += buffers[b].size();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_flight[b] = true;
+        }
+        if(uses_io_uring)
+            submit_io_uring(b, 0, offset);
+        else
+            pool->submit([this, b, offset] { finish_buffer(b, pwrite_buffer(b, 0, offset)); });
+
+        // Next buffer in round-robin order, waiting only if it is still being written
+        current = (current + 1) % buffers.size();
+        wait_for_buffer(current);
+    }
+
+    // Blocking write of buffer b from byte done onwards
+    bool pwrite_buffer(int b, size_t done, off_t offset)
+    {
+        while(done < buffers[b].size())
+        {
+            ssize_t res = pwrite(fd, buffers[b].data() + done, buffers[b].size() - done, offset + done);
+            if(res < 0 && errno == EINTR)
+                continue;
+            if(res <= 0)
+                return false;
+            done += res;
+        }
+        return true;
+    }
+
+    void finish_buffer(int b, bool ok)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!ok)
+            failed = true;
+        buffers[b].clear();
+        in_flight[b] = false;
+        buffer_done.notify_all();
+    }
+
+    void wait_for_buffer(int b)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        if(uses_io_uring)
+        {
+            while(in_flight[b])
+                reap_io_uring(true);
+        }
+        else
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            buffer_done.wait(lock, [this, b] { return !in_flight[b]; });
+        }
+
+        std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+        blocked_ms += duration.count();
+    }
+
+#if HAVE_IO_URING
+    // Minimal io_uring driven through raw syscalls (no liburing)
+    bool setup_io_uring()
+    {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ring_fd = syscall(__NR_io_uring_setup, ASYNC_WRITE_BUFFERS * 2, &params);
+        if(ring_fd < 0)
+            return false;
+
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        sqes = (struct io_uring_sqe*)mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if(sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED)
+        {
+            teardown_io_uring();
+            return false;
+        }
+
+        sq_head = (uint32_t*)((char*)sq_ring + params.sq_off.head);
+        sq_tail = (uint32_t*)((char*)sq_ring + params.sq_off.tail);
+        sq_mask = (uint32_t*)((char*)sq_ring + params.sq_off.ring_mask);
+        sq_array = (uint32_t*)((char*)sq_ring + params.sq_off.array);
+        cq_head = (uint32_t*)((char*)cq_ring + params.cq_off.head);
+        cq_tail = (uint32_t*)((char*)cq_ring + params.cq_off.tail);
+        cq_mask = (uint32_t*)((char*)cq_ring + params.cq_off.ring_mask);
+        cqes = (struct io_uring_cqe*)((char*)cq_ring + params.cq_off.cqes);
+
+        iovecs.resize(ASYNC_WRITE_BUFFERS);
+        submitted.assign(ASYNC_WRITE_BUFFERS, 0);
+        offsets.assign(ASYNC_WRITE_BUFFERS, 0);
+        return true;
+    }
+
+    void teardown_io_uring()
+    {
+        if(sqes != nullptr && sqes != MAP_FAILED)
+            munmap(sqes, sqes_size);
+        if(cq_ring != nullptr && cq_ring != MAP_FAILED)
+            munmap(cq_ring, cq_ring_size);
+        if(sq_ring != nullptr && sq_ring != MAP_FAILED)
+            munmap(sq_ring, sq_ring_size);
+        if(ring_fd >= 0)
+            ::close(ring_fd);
+
+        sqes = nullptr;
+        cq_ring = sq_ring = nullptr;
+        ring_fd = -1;
+    }
+
+    // io_uring_enter, retried on EINTR and (a bounded number of times) on EAGAIN / EBUSY
+    int enter_io_uring(unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+        for(int attempt = 0; ; attempt++)
+        {
+            int res = syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0);
+            if(res >= 0 || (errno != EINTR && ((errno != EAGAIN && errno != EBUSY) || attempt >= 100)))
+                return res;
+            if(errno != EINTR)
+                sched_yield();
+        }
+    }
+
+    // Queue buffer b from byte done onwards
+    // Once submitting failed the ring takes no new writes: buffers are written here with pwrite,
+    // while entries the kernel already took still complete through reap_io_uring()
+    void submit_io_uring(int b, size_t done, off_t offset)
+    {
+        if(ring_failed)
+        {
+            finish_buffer(b, pwrite_buffer(b, done, offset));
+            return;
+        }
+
+        submitted[b] = done;
+        offsets[b] = offset;
+        iovecs[b].iov_base = buffers[b].data() + done;
+        iovecs[b].iov_len = buffers[b].size() - done;
+
+        uint32_t tail = __atomic_load_n(sq_tail, __ATOMIC_ACQUIRE);
+        uint32_t index = tail & *sq_mask;
+        struct io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)&iovecs[b];
+        sqe->len = 1;
+        sqe->off = offset + done;
+        sqe->user_data = b;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        if(enter_io_uring(1, 0, 0) >= 0)
+            return;
+
+        // The entry is published, so the kernel may still pick it up: only an entry it never
+        // consumed is taken back and written here. Otherwise its completion finishes b.
+        ring_failed = true;
+        if(__atomic_load_n(sq_head, __ATOMIC_ACQUIRE) == tail)
+        {
+            __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+            finish_buffer(b, pwrite_buffer(b, done, offset));
+        }
+    }
+
+    void reap_io_uring(bool wait)
+    {
+        uint32_t head = __atomic_load_n(cq_head, __ATOMIC_ACQUIRE);
+        if(head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+        {
+            if(!wait)
+                return;
+            // On failure the caller polls again; writes already queued complete regardless
+            enter_io_uring(0, 1, IORING_ENTER_GETEVENTS);
+        }
+
+        while(head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+        {
+            struct io_uring_cqe* cqe = &cqes[head & *cq_mask];
+            int b = (int)cqe->user_data;
+            int res = cqe->res;
+            head++;
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+            // Short writes are resubmitted for the remainder
+            size_t done = submitted[b] + (res > 0 ? res : 0);
+            if(res <= 0)
+                finish_buffer(b, false);
+            else if(done < buffers[b].size())
+                submit_io_uring(b, done, offsets[b]);
+            else
+                finish_buffer(b, true);
+        }
+    }
+
+    int ring_fd = -1;
+    void* sq_ring = nullptr;
+    void* cq_ring = nullptr;
+    struct io_uring_sqe* sqes = nullptr;
+    size_t sq_ring_size = 0, cq_ring_size = 0, sqes_size = 0;
+    bool ring_failed = false;
+    uint32_t *sq_head = nullptr, *sq_tail = nullptr, *sq_mask = nullptr, *sq_array = nullptr;
+    uint32_t *cq_head = nullptr, *cq_tail = nullptr, *cq_mask = nullptr;
+    struct io_uring_cqe* cqes = nullptr;
+    std::vector<struct iovec> iovecs;
+    std::vector<size_t> submitted;
+    std::vector<off_t> offsets;
+#else
+    bool setup_io_uring() { return false; }
+    void teardown_io_uring() {}
+    void submit_io_uring(int, size_t, off_t) {}
+    void reap_io_uring(bool) {}
+#endif
+
+    int fd = -1;
+    off_t file_offset = 0;
+    int current = 0;
+    bool failed = false;
+    std::vector<std::vector<char>> buffers;
+    std::vector<bool> in_flight;
+    std::unique_ptr<ThreadPool> pool;
+    std::mutex mutex;
+    std::condition_variable buffer_done;
+};
+// ===============================================================
+
+#endif
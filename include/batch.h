@@ -0,0 +1,243 @@
+#ifndef BATCH
+#define BATCH
+
+#include <fstream>
+#include <sstream>
+
+#include "include.h"
+#include "parameters.h"
+#include "utility.h"
+#include "pointcloud_io.h"
+#include "extractor.h"
+#include "mesh_cleanup.h"
+#include "mesh_decimate.h"
+#include "mesh_optimize.h"
+#include "morton_order.h"
+#include "save_ply.h"
+#include "thread_pool.h"
+
+// ===============================================================
+// Batch mode: many inputs meshed by one process, so startup is paid once
+// - manifest: one "<INPUT> <OUTPUT>" pair per line (paths without spaces, relative to the
+//   working directory); blank lines and lines starting with # are skipped
+// - jobs run concurrently on one ThreadPool, one job per worker at a time; each worker keeps
+//   a serial MarchingTetrahedra and its output mesh from one job to the next
+// - a job reads its input, builds the density grid, marches, runs cleanup / decimation /
+//   vertex cache optimisation / Morton vertex order as configured and writes .mtz or PLY; grid
+//   and result caches, ROI, tiled, pipelined and shared memory output are single-run
+//   features and not used
+struct BatchJob
+{
+    std::string input_path;
+    std::string output_path;
+
+    bool ok = false;
+    size_t num_points = 0;
+    size_t num_triangles = 0;
+    double read_ms = 0;
+    double grid_ms = 0;
+    double march_ms = 0;
+    double post_ms = 0;
+    double write_ms = 0;
+    double total_ms = 0;
+};
+
+bool read_batch_manifest(const std::string &path, std::vector<BatchJob> &jobs)
+{
+    std::ifstream manifest(path);
+    if(!manifest)
+        return false;
+
+    std::string line;
+    while(std::getline(manifest, line))
+    {
+        std::istringstream fields(line);
+        BatchJob job;
+        if(!(fields >> job.input_path) || job.input_path[0] == '#')
+            continue;
+        if(!(fields >> job.output_path))
+            return false;
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+// Pointcloud bounds and the voxel size a single run uses at num_voxel (unit voxels if num_voxel
+// is 0, as for generated pointclouds)
+struct GridBounds
+{
+    float min_x, min_y, min_z;
+    float max_x, max_y, max_z;
+    float voxel_dx = 1, voxel_dy = 1, voxel_dz = 1;
+};
+
+GridBounds grid_bounds_for_pointcloud(std::vector<Vec3f> &pointcloud, int num_voxel)
+{
+    GridBounds bounds;
+    find_min_pixel(pointcloud, bounds.min_x, bounds.min_y, bounds.min_z);
+    find_max_pixel(pointcloud, bounds.max_x, bounds.max_y, bounds.max_z);
+    if(num_voxel > 0)
+        cal_voxel_size(bounds.min_x, bounds.min_y, bounds.min_z, bounds.max_x, bounds.max_y, bounds.max_z,
+                       bounds.voxel_dx, bounds.voxel_dy, bounds.voxel_dz, num_voxel);
+    if(bounds.voxel_dx == 0)
+        bounds.voxel_dx = 1;
+    if(bounds.voxel_dy == 0)
+        bounds.voxel_dy = 1;
+    if(bounds.voxel_dz == 0)
+        bounds.voxel_dz = 1;
+    return bounds;
+}
+
+DensityGrid build_grid_in_bounds(std::vector<Vec3f> &pointcloud, const GridBounds &bounds)
+{
+    return build_density_grid(pointcloud, bounds.min_x, bounds.min_y, bounds.min_z, bounds.max_x, bounds.max_y, bounds.max_z,
+                              bounds.voxel_dx, bounds.voxel_dy, bounds.voxel_dz);
+}
+
+DensityGrid build_grid_for_pointcloud(std::vector<Vec3f> &pointcloud, int num_voxel)
+{
+    return build_grid_in_bounds(pointcloud, grid_bounds_for_pointcloud(pointcloud, num_voxel));
+}
+
+// What each step of postprocess_mesh() did and took, for a single run to print
+struct PostprocessReport
+{
+    MeshCleanupStats cleanup;
+    double clean_ms = 0;
+    size_t faces_before_decimation = 0;
+    DecimateStats decimation;
+    double decimate_ms = 0;
+    double acmr_before = 0, acmr_after = 0;
+    double optimize_ms = 0;
+    double index_distance_before = 0, index_distance_after = 0;
+    int morton_threads = 0;
+    double morton_ms = 0;
+};
+
+// Cleanup, decimation, vertex cache optimisation and Morton vertex order as configured
+// - the Morton sort gets a pool of num_threads (0 = every core); jobs that already run one per
+//   core pass 1
+// - ACMR and index distances are only measured when a report is asked for
+void postprocess_mesh(IndexedMesh &mesh, const DensityGrid &grid, int num_threads = 1, PostprocessReport* report = nullptr)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    auto elapsed_ms = [](Clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    };
+    PostprocessReport unused;
+    PostprocessReport &r = report ? *report : unused;
+    float spacing = std::min({grid.dx, grid.dy, grid.dz});
+
+    if(CLEAN_MESH)
+    {
+        auto start = Clock::now();
+        clean_mesh(mesh, WELD_TOLERANCE * spacing, r.cleanup);
+        r.clean_ms = elapsed_ms(start);
+    }
+    if(DECIMATE)
+    {
+        auto start = Clock::now();
+        r.faces_before_decimation = mesh.num_faces();
+        double max_distance = DECIMATE_MAX_ERROR * spacing;
+        decimate_mesh(mesh, (size_t)(mesh.num_faces() * DECIMATE_TARGET_RATIO), max_distance * max_distance, r.decimation);
+        r.decimate_ms = elapsed_ms(start);
+    }
+    if(OPTIMIZE_VERTEX_CACHE)
+    {
+        auto start = Clock::now();
+        if(report)
+            r.acmr_before = compute_acmr(mesh, VERTEX_CACHE_SIZE);
+        optimize_vertex_cache(mesh, VERTEX_CACHE_SIZE);
+        if(report)
+            r.acmr_after = compute_acmr(mesh, VERTEX_CACHE_SIZE);
+        r.optimize_ms = elapsed_ms(start);
+    }
+    if(MORTON_VERTEX_ORDER)
+    {
+        auto start = Clock::now();
+        ThreadPool pool(num_threads);
+        if(report)
+            r.index_distance_before = mean_face_index_distance(mesh);
+        sort_vertices_by_morton_code(mesh, pool);
+        if(report)
+            r.index_distance_after = mean_face_index_distance(mesh);
+        r.morton_threads = pool.size();
+        r.morton_ms = elapsed_ms(start);
+    }
+}
+
+// .mtz or PLY from the extension
+bool write_mesh_file(const IndexedMesh &mesh, const DensityGrid &grid, const std::string &path)
+{
+    if(has_extension(path, ".mtz"))
+    {
+        MeshCodecStats stats;
+        return write_to_mtz(mesh, grid, path.c_str(), stats);
+    }
+    return write_to_ply(mesh, path.c_str()) >= 0;
+}
+
+void run_batch_job(BatchJob &job, MarchingTetrahedra &extractor, IndexedMesh &mesh)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    auto elapsed_ms = [](Clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    };
+    auto start_job = Clock::now();
+
+    auto start = Clock::now();
+    std::vector<Vec3f> pointcloud = get_pointcloud_from_file(job.input_path);
+    job.num_points = pointcloud.size();
+    job.read_ms = elapsed_ms(start);
+    if(pointcloud.empty())
+    {
+        job.total_ms = elapsed_ms(start_job);
+        return;
+    }
+
+    start = Clock::now();
+    DensityGrid grid = build_grid_for_pointcloud(pointcloud, runtime_parameters().num_voxel);
+    job.grid_ms = elapsed_ms(start);
+
+    start = Clock::now();
+    extractor.extract(grid, runtime_parameters().isovalue, mesh);
+    job.march_ms = elapsed_ms(start);
+
+    start = Clock::now();
+    postprocess_mesh(mesh, grid);
+    job.post_ms = elapsed_ms(start);
+    job.num_triangles = mesh.num_faces();
+
+    start = Clock::now();
+    job.ok = write_mesh_file(mesh, grid, job.output_path);
+    job.write_ms = elapsed_ms(start);
+    job.total_ms = elapsed_ms(start_job);
+}
+
+// Serial extractor for a worker of a pool that runs whole jobs in parallel
+ExtractorConfig serial_extractor_config()
+{
+    ExtractorConfig config;
+    config.num_threads = 1;
+    return config;
+}
+
+// Runs every job on the pool, returns the wall time in ms
+double run_batch(std::vector<BatchJob> &jobs, ThreadPool &pool)
+{
+    auto start_batch = std::chrono::high_resolution_clock::now();
+
+    for(size_t j = 0; j < jobs.size(); j++)
+        pool.submit([&jobs, j] {
+            static thread_local MarchingTetrahedra extractor(serial_extractor_config());
+            static thread_local IndexedMesh mesh;
+            run_batch_job(jobs[j], extractor, mesh);
+        });
+    pool.wait();
+
+    std::chrono::duration<double, std::milli> batch_duration = std::chrono::high_resolution_clock::now() - start_batch;
+    return batch_duration.count();
+}
+// ===============================================================
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef CONCURRENT_WELD
+#define CONCURRENT_WELD
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// ===============================================================
+// Lock-free edge ID -> vertex index table shared by the threads marching one mesh
+// - fixed capacity (2 slots per expected key, never grows while marching), collisions probe linearly
+// - insert claims an empty slot by CAS on its key, the winner takes the next index from a
+//   shared counter and publishes it; a thread meeting the key meanwhile waits for that store
+// - indices are dense in [0, size()) but their order depends on thread timing
+class ConcurrentEdgeMap
+{
+public:
+    // max_entries: most distinct keys that will be inserted
+    explicit ConcurrentEdgeMap(size_t max_entries = 0) { reset(max_entries); }
+
+    // Empty table for up to max_entries keys; the slots are reused if there are enough
+    // Not thread safe, call between marches
+    void reset(size_t max_entries)
+    {
+        size_t needed = 16;
+        while(needed < 2 * max_entries)
+            needed <<= 1;
+        if(needed > keys.size())
+        {
+            keys = std::vector<std::atomic<uint64_t>>(needed);
+            values = std::vector<std::atomic<int32_t>>(needed);
+        }
+        capacity = keys.size();
+
+        for(size_t s = 0; s < capacity; s++)
+        {
+            keys[s].store(EMPTY_KEY, std::memory_order_relaxed);
+            values[s].store(-1, std::memory_order_relaxed);
+        }
+        next_index.store(0, std::memory_order_relaxed);
+    }
+
+    // Index of key; a new key gets the next free index and inserted is set
+    // Returns -1 only if more than max_entries keys were inserted and the table is full
+    int find_or_insert(uint64_t key, bool &inserted)
+    {
+        inserted = false;
+        size_t mask = capacity - 1;
+        size_t s = hash_key(key) & mask;
+        for(size_t probes = 0; probes < capacity; probes++, s = (s + 1) & mask)
+        {
+            uint64_t slot_key = keys[s].load(std::memory_order_acquire);
+            if(slot_key == EMPTY_KEY)
+            {
+                if(keys[s].compare_exchange_strong(slot_key, key, std::memory_order_acq_rel))
+                {
+                    int32_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+                    values[s].store(index, std::memory_order_release);
+                    inserted = true;
+                    return index;
+                }
+                // Lost the slot, slot_key now holds the winner's key
+            }
+            if(slot_key == key)
+            {
+                int32_t index;
+                while((index = values[s].load(std::memory_order_acquire)) < 0)
+                    std::this_thread::yield();
+                return index;
+            }
+        }
+        return -1;
+    }
+
+    size_t size() const { return next_index.load(std::memory_order_acquire); }
+
+private:
+    static const uint64_t EMPTY_KEY = ~(uint64_t)0;
+
+    static size_t hash_key(uint64_t key)
+    {
+        key ^= key >> 31;
+        key *= 0x9E3779B97F4A7C15ULL;
+        key ^= key >> 29;
+        return (size_t)key;
+    }
+
+    size_t capacity;
+    std::vector<std::atomic<uint64_t>> keys;
+    std::vector<std::atomic<int32_t>> values;
+    std::atomic<int32_t> next_index{0};
+};
+// ===============================================================
+
+#endif
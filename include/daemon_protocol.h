@@ -0,0 +1,106 @@
+#ifndef DAEMON_PROTOCOL
+#define DAEMON_PROTOCOL
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ===============================================================
+// Meshing daemon protocol over a UNIX domain stream socket, one job per connection
+// Request: one text line, then the payload if any
+//   MESH <INPUT_PATH> <OUTPUT_PATH or -> [ISOVALUE [NUM_VOXEL]]
+//   POINTS <NUM_POINTS> <OUTPUT_PATH or -> [ISOVALUE [NUM_VOXEL]]
+//                                                          then NUM_POINTS * 3 float32 (x, y, z)
+//   NUM_POINTS at most DAEMON_MAX_POINTS; ISOVALUE and NUM_VOXEL default to the daemon's runtime parameters
+//   SHUTDOWN
+// Reply: one text line
+//   OK <NUM_VERTICES> <NUM_FACES> <MILLISECONDS>           output path "-": followed by
+//                                                          NUM_VERTICES * 3 float32, NUM_FACES * 3 uint32
+//   ERROR <MESSAGE>
+// Binary data is in host byte order, both ends run on the same machine.
+static const size_t DAEMON_MAX_LINE = 4096;
+// Largest NUM_POINTS accepted (768 MB of float32 xyz)
+static const size_t DAEMON_MAX_POINTS = (size_t)1 << 26;
+
+bool write_all(int fd, const void* data, size_t size)
+{
+    const char* cur = (const char*)data;
+    while(size > 0)
+    {
+        ssize_t written = send(fd, cur, size, MSG_NOSIGNAL);
+        if(written <= 0)
+            return false;
+        cur += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool read_all(int fd, void* data, size_t size)
+{
+    char* cur = (char*)data;
+    while(size > 0)
+    {
+        ssize_t got = recv(fd, cur, size, 0);
+        if(got <= 0)
+            return false;
+        cur += got;
+        size -= got;
+    }
+    return true;
+}
+
+// Line without the '\n'; false on EOF or a line longer than DAEMON_MAX_LINE
+// Reads byte by byte so the payload after the line stays in the socket
+bool read_line(int fd, std::string &line)
+{
+    line.clear();
+    char c;
+    while(line.size() < DAEMON_MAX_LINE)
+    {
+        if(recv(fd, &c, 1, 0) != 1)
+            return false;
+        if(c == '\n')
+            return true;
+        line.push_back(c);
+    }
+    return false;
+}
+
+bool write_line(int fd, const std::string &line)
+{
+    return write_all(fd, (line + "\n").data(), line.size() + 1);
+}
+
+bool make_socket_address(const std::string &path, sockaddr_un &address)
+{
+    if(path.size() >= sizeof(address.sun_path))
+        return false;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Connected socket, -1 if no daemon listens on path
+int connect_to_daemon(const std::string &path)
+{
+    sockaddr_un address;
+    if(!make_socket_address(path, address))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+        return -1;
+    if(connect(fd, (sockaddr*)&address, sizeof(address)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+// ===============================================================
+
+#endif
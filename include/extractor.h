@@ -0,0 +1,179 @@
+#ifndef EXTRACTOR
+#define EXTRACTOR
+
+#include <atomic>
+#include <memory>
+
+#include "include.h"
+#include "parameters.h"
+#include "marching_tetrahedrons.h"
+#include "mesh_cleanup.h"
+#include "thread_pool.h"
+
+// ===============================================================
+// Isosurface extraction as a long-lived object, for callers marching many grids in a row
+// (sweeps, batches, a server)
+// - the thread pool, the edge ID tables and the per-layer counts are kept between calls and only
+//   cleared, so once a grid of the same size has been marched, marching and welding allocate
+//   nothing; reusing the output mesh keeps its capacity as well
+// - threaded extraction: every z layer of voxels is marched by whichever worker is free straight
+//   into the output mesh, vertices at global indices from one ConcurrentEdgeMap and faces at the
+//   layer's offset (from per-layer case table counts); indices are then renumbered in first-use
+//   order and vertices permuted to match in place, which gives the serial output exactly with
+//   a single copy of the mesh
+// - with corner snapping, triangles snapped onto the same three vertices from different
+//   tetrahedrons are kept once (remove_duplicate_faces())
+struct ExtractorConfig
+{
+    int num_threads = MARCH_THREADS;         // 0: every core, 1: serial MeshBuilder
+    float snap_threshold = SNAP_THRESHOLD;
+    bool keep_edge_ids = false;
+};
+
+class MarchingTetrahedra
+{
+public:
+    explicit MarchingTetrahedra(const ExtractorConfig &config = ExtractorConfig())
+        : config(config)
+    {
+        int num_threads = resolve_num_threads(config.num_threads);
+        if (num_threads > 1)
+            pool.reset(new ThreadPool(num_threads));
+    }
+
+    int num_threads() const { return pool ? pool->size() : 1; }
+
+    // Replaces the contents of mesh
+    void extract(const DensityGrid &grid, float isovalue, IndexedMesh &mesh)
+    {
+        mesh.clear();
+        if (grid.nx < 2 || grid.ny < 2 || grid.nz < 2)
+            return;
+
+        if (!pool)
+        {
+            edgeMap.clear();
+            MeshBuilder triangles(mesh, edgeMap, config.keep_edge_ids);
+            march_cells(grid, isovalue, config.snap_threshold, triangles, 0, grid.nx - 1, 0, grid.ny - 1, 0, grid.nz - 1);
+        }
+        else
+            extract_parallel(grid, isovalue, mesh);
+
+        if (config.snap_threshold > 0)
+            remove_duplicate_faces(mesh, faceSet);
+    }
+
+private:
+    void extract_parallel(const DensityGrid &grid, float isovalue, IndexedMesh &mesh)
+    {
+        int num_layers = grid.nz - 1;
+
+        // Upper bounds: crossing edges on the vertices, case table triangles on each layer's faces
+        layer_crossings.resize(grid.nz);
+        layer_offsets.resize(num_layers + 1);
+        for_each_layer(grid.nz, [&](int k) {
+            layer_crossings[k] = count_crossing_edges(grid, isovalue, k, k + 1);
+            if (k < num_layers)
+                layer_offsets[k + 1] = 3 * count_case_triangles(grid, isovalue, k, k + 1);
+        });
+        size_t max_vertices = 0;
+        for (int k = 0; k < grid.nz; k++)
+            max_vertices += layer_crossings[k];
+        layer_offsets[0] = 0;
+        for (int k = 0; k < num_layers; k++)
+            layer_offsets[k + 1] += layer_offsets[k];
+
+        // Layers write vertices and indices straight into the output mesh
+        mesh.x.resize(max_vertices);
+        mesh.y.resize(max_vertices);
+        mesh.z.resize(max_vertices);
+        mesh.edge_ids.resize(config.keep_edge_ids ? max_vertices : 0);
+        mesh.indices.resize(layer_offsets[num_layers]);
+        concurrentEdgeMap.reset(max_vertices);
+        layer_sizes.resize(num_layers);
+        for_each_layer(num_layers, [&](int k) {
+            ConcurrentMeshBuilder triangles(mesh, concurrentEdgeMap, mesh.indices.data() + layer_offsets[k]);
+            march_cells(grid, isovalue, config.snap_threshold, triangles, 0, grid.nx - 1, 0, grid.ny - 1, k, k + 1);
+            layer_sizes[k] = triangles.num_indices();
+        });
+
+        // Close the gaps of triangles dropped by snapping (nothing moves without it)
+        size_t num_refs = 0;
+        for (int k = 0; k < num_layers; k++)
+        {
+            if (layer_offsets[k] != num_refs)
+                std::copy(mesh.indices.begin() + layer_offsets[k], mesh.indices.begin() + layer_offsets[k] + layer_sizes[k],
+                          mesh.indices.begin() + num_refs);
+            num_refs += layer_sizes[k];
+        }
+        mesh.indices.resize(num_refs);
+
+        // Renumber in first-use order; every vertex the map numbered is used by a face
+        uint32_t num_vertices = concurrentEdgeMap.size();
+        first_use.assign(num_vertices, UINT32_MAX);
+        uint32_t next_vertex = 0;
+        for (uint32_t &index: mesh.indices)
+        {
+            if (first_use[index] == UINT32_MAX)
+                first_use[index] = next_vertex++;
+            index = first_use[index];
+        }
+
+        // Move vertex i to first_use[i] by following permutation cycles
+        mesh.x.resize(num_vertices);
+        mesh.y.resize(num_vertices);
+        mesh.z.resize(num_vertices);
+        if (config.keep_edge_ids)
+            mesh.edge_ids.resize(num_vertices);
+        for (uint32_t i = 0; i < num_vertices; i++)
+            while (first_use[i] != i)
+            {
+                uint32_t j = first_use[i];
+                std::swap(mesh.x[i], mesh.x[j]);
+                std::swap(mesh.y[i], mesh.y[j]);
+                std::swap(mesh.z[i], mesh.z[j]);
+                if (config.keep_edge_ids)
+                    std::swap(mesh.edge_ids[i], mesh.edge_ids[j]);
+                std::swap(first_use[i], first_use[j]);
+            }
+    }
+
+    // task(k) for k in [0, num_layers), one pool task per worker taking layers in turn
+    // (a single captured pointer keeps std::function from allocating)
+    template <typename Task>
+    void for_each_layer(int num_layers, const Task &task)
+    {
+        struct LayerQueue
+        {
+            std::atomic<int> next_layer{0};
+            int num_layers;
+            const Task* task;
+        } queue;
+        queue.num_layers = num_layers;
+        queue.task = &task;
+
+        for (int t = 0; t < pool->size(); t++)
+            pool->submit([&queue] {
+                for (int k; (k = queue.next_layer.fetch_add(1)) < queue.num_layers; )
+                    (*queue.task)(k);
+            });
+        pool->wait();
+    }
+
+    ExtractorConfig config;
+    std::unique_ptr<ThreadPool> pool;
+    FaceHashSet faceSet;
+
+    // Serial
+    EdgeHashMap edgeMap;
+
+    // Threaded
+    ConcurrentEdgeMap concurrentEdgeMap;
+    std::vector<size_t> layer_crossings;
+    std::vector<size_t> layer_offsets;
+    std::vector<size_t> layer_sizes;
+    std::vector<uint32_t> first_use;
+};
+// ===============================================================
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef GRID_CACHE
+#define GRID_CACHE
+
+#include <cstring>
+#include <cstdio>
+
+#include "include.h"
+#include "parameters.h"
+#include "runtime_parameters.h"
+#include "mapped_file.h"
+
+// ===============================================================
+// Binary density grid cache
+// layout: GridCacheHeader | payload
+//   GRID_CACHE_FLOAT32 : nx * ny * nz raw float densities
+//   GRID_CACHE_SIGN_BIT: one bit per node (1 -> density -1, 0 -> density 1)
+#define GRID_CACHE_FLOAT32 0
+#define GRID_CACHE_SIGN_BIT 1
+
+struct GridCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t type;
+    int32_t nx, ny, nz;
+    int32_t num_voxel;
+    float origin[3];
+    float spacing[3];
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t payload_size;
+};
+
+static const char GRID_CACHE_MAGIC[8] = {'M', 'T', 'G', 'R', 'I', 'D', '\0', '\0'};
+static const uint32_t GRID_CACHE_VERSION = 1;
+
+std::string grid_cache_path(const std::string &input_path)
+{
+    return input_path + ".grid";
+}
+
+// Cache is only valid for the exact input file it was built from
+bool get_source_stamp(const std::string &input_path, uint64_t &size, int64_t &mtime)
+{
+    struct stat st;
+    if(stat(input_path.c_str(), &st) != 0)
+        return false;
+
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+bool load_grid_cache(const std::string &cache_path, const std::string &input_path, DensityGrid &grid)
+{
+    uint64_t source_size;
+    int64_t source_mtime;
+    if(!get_source_stamp(input_path, source_size, source_mtime))
+        return false;
+
+    MappedFile file;
+    if(!map_file(cache_path.c_str(), file))
+        return false;
+
+    GridCacheHeader header;
+    bool valid = file.size >= sizeof(header);
+    if(valid)
+    {
+        memcpy(&header, file.data, sizeof(header));
+        valid = memcmp(header.magic, GRID_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+                header.version == GRID_CACHE_VERSION &&
+                header.num_voxel == runtime_parameters().num_voxel &&
+                header.source_size == source_size &&
+                header.source_mtime == source_mtime &&
+                file.size == sizeof(header) + header.payload_size;
+    }
+
+    size_t num_nodes = valid ? (size_t)header.nx * header.ny * header.nz : 0;
+    if(valid && header.type == GRID_CACHE_FLOAT32)
+        valid = header.payload_size == num_nodes * sizeof(float);
+    else if(valid && header.type == GRID_CACHE_SIGN_BIT)
+        valid = header.payload_size == (num_nodes + 7) / 8;
+    else
+        valid = false;
+
+    if(!valid)
+    {
+        unmap_file(file);
+        return false;
+    }
+
+    grid.nx = header.nx;
+    grid.ny = header.ny;
+    grid.nz = header.nz;
+    grid.origin_x = header.origin[0];
+    grid.origin_y = header.origin[1];
+    grid.origin_z = header.origin[2];
+    grid.dx = header.spacing[0];
+    grid.dy = header.spacing[1];
+    grid.dz = header.spacing[2];
+
+    const char* payload = file.data + sizeof(header);
+    grid.density.resize(num_nodes);
+    if(header.type == GRID_CACHE_FLOAT32)
+        memcpy(grid.density.data(), payload, num_nodes * sizeof(float));
+    else
+    {
+        const uint8_t* bits = (const uint8_t*)payload;
+        for(size_t n = 0; n < num_nodes; n++)
+            grid.density[n] = (bits[n >> 3] >> (n & 7)) & 1 ? -1 : 1;
+    }
+
+    unmap_file(file);
+    return true;
+}
+
+bool save_grid_cache(const std::string &cache_path, const std::string &input_path, const DensityGrid &grid)
+{
+    GridCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GRID_CACHE_MAGIC, sizeof(header.magic));
+    header.version = GRID_CACHE_VERSION;
+    header.nx = grid.nx;
+    header.ny = grid.ny;
+    header.nz = grid.nz;
+    header.num_voxel = runtime_parameters().num_voxel;
+    header.origin[0] = grid.origin_x;
+    header.origin[1] = grid.origin_y;
+    header.origin[2] = grid.origin_z;
+    header.spacing[0] = grid.dx;
+    header.spacing[1] = grid.dy;
+    header.spacing[2] = grid.dz;
+    if(!get_source_stamp(input_path, header.source_size, header.source_mtime))
+        return false;
+
+    // Densities built from pointclouds are only -1 or 1, store them as bits
+    bool is_sign_only = true;
+    for(size_t n = 0; n < grid.density.size() && is_sign_only; n++)
+        is_sign_only = grid.density[n] == -1 || grid.density[n] == 1;
+
+    std::vector<uint8_t> bits;
+    const char* payload = (const char*)grid.density.data();
+    header.type = GRID_CACHE_FLOAT32;
+    header.payload_size = grid.density.size() * sizeof(float);
+    if(is_sign_only)
+    {
+        bits.assign((grid.density.size() + 7) / 8, 0);
+        for(size_t n = 0; n < grid.density.size(); n++)
+            if(grid.density[n] == -1)
+                bits[n >> 3] |= 1 << (n & 7);
+
+        payload = (const char*)bits.data();
+        header.type = GRID_CACHE_SIGN_BIT;
+        header.payload_size = bits.size();
+    }
+
+    // Write next to the target and rename, so readers never see a partial file
+    std::string tmp_path = cache_path + ".tmp";
+    FILE* outputFile = fopen(tmp_path.c_str(), "wb");
+    if(outputFile == nullptr)
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, outputFile) == 1 &&
+              fwrite(payload, 1, header.payload_size, outputFile) == header.payload_size;
+    ok = (fclose(outputFile) == 0) && ok;
+
+    if(!ok || rename(tmp_path.c_str(), cache_path.c_str()) != 0)
+    {
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+// ===============================================================
+
+#endif
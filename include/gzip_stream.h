@@ -0,0 +1,283 @@
+#ifndef GZIP_STREAM
+#define GZIP_STREAM
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <zlib.h>
+
+#include "include.h"
+#include "parameters.h"
+#include "utility.h"
+#include "thread_pool.h"
+
+// ===============================================================
+// Streaming gzip input (.txt.gz / .ply.gz)
+// A decompression thread inflates GZIP_BLOCK_SIZE blocks into a queue while the caller parses
+
+bool is_gzip_file(const std::string &path)
+{
+    unsigned char magic[2] = {0, 0};
+    FILE* inputFile = fopen(path.c_str(), "rb");
+    if(inputFile == nullptr)
+        return false;
+    size_t num_read = fread(magic, 1, 2, inputFile);
+    fclose(inputFile);
+
+    return num_read == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+// Decompression stage, whole_lines keeps text blocks ending on a newline
+// busy_ms accumulates time spent reading and inflating
+// Returns false if the file can't be read or the gzip stream is corrupt or truncated
+bool inflate_blocks(const std::string &path, bool whole_lines, BoundedQueue<std::string> &blocks, double &busy_ms)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    FILE* inputFile = fopen(path.c_str(), "rb");
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // 16 + MAX_WBITS: expect a gzip header
+    bool ok = inputFile != nullptr && inflateInit2(&stream, 16 + MAX_WBITS) == Z_OK;
+
+    std::vector<unsigned char> input(GZIP_BLOCK_SIZE / 4);
+    std::string block;
+    bool finished = !ok;
+    bool input_done = false;
+    while(!finished)
+    {
+        if(stream.avail_in == 0 && !input_done)
+        {
+            stream.avail_in = fread(input.data(), 1, input.size(), inputFile);
+            stream.next_in = input.data();
+            // zlib may still hold output after the last input, inflate until it stops progressing
+            input_done = stream.avail_in == 0;
+        }
+
+        size_t offset = block.size();
+        block.resize(GZIP_BLOCK_SIZE);
+        stream.next_out = (Bytef*)&block[offset];
+        stream.avail_out = block.size() - offset;
+
+        int status = inflate(&stream, Z_NO_FLUSH);
+        block.resize(block.size() - stream.avail_out);
+        if(status == Z_STREAM_END)
+        {
+            // Concatenated gzip members continue after the end of a stream
+            if(stream.avail_in > 0 || !feof(inputFile))
+                inflateReset(&stream);
+            else
+                finished = true;
+        }
+        else if(status != Z_OK && status != Z_BUF_ERROR)
+            break;
+        else if(status == Z_BUF_ERROR && input_done)
+            // No progress without more input: the stream was cut short
+            break;
+
+        if(block.size() < GZIP_BLOCK_SIZE && !finished)
+            continue;
+
+        std::string carry;
+        if(whole_lines && !finished)
+        {
+            size_t last_newline = block.find_last_of('\n');
+            if(last_newline != std::string::npos)
+            {
+                carry = block.substr(last_newline + 1);
+                block.resize(last_newline + 1);
+            }
+        }
+
+        busy_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        blocks.push(std::move(block));
+        start = std::chrono::high_resolution_clock::now();
+
+        block = std::move(carry);
+    }
+    if(!block.empty())
+        blocks.push(std::move(block));
+
+    if(ok)
+        inflateEnd(&stream);
+    if(inputFile != nullptr)
+        fclose(inputFile);
+
+    busy_ms += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    blocks.close();
+    return finished && ok;
+}
+
+// Incremental PLY vertex reader (ascii / binary_little_endian), vertex element must come first
+struct PlyStreamParser
+{
+    bool in_header = true;
+    bool failed = false;
+    bool binary = false;
+    size_t num_vertices = 0;
+    size_t num_read = 0;
+    size_t record_size = 0;
+    int num_properties = 0;
+    int xyz_property[3] = {-1, -1, -1};
+    size_t xyz_offset[3] = {0, 0, 0};
+    int xyz_size[3] = {4, 4, 4};
+    bool in_vertex_element = false;
+    std::string pending;
+};
+
+int ply_type_size(const std::string &type)
+{
+    if(type == "char" || type == "uchar" || type == "int8" || type == "uint8")
+        return 1;
+    if(type == "short" || type == "ushort" || type == "int16" || type == "uint16")
+        return 2;
+    if(type == "double" || type == "float64")
+        return 8;
+    return 4;
+}
+
+void parse_ply_header_line(const std::string &text, PlyStreamParser &parser)
+{
+    std::istringstream line(text);
+    std::string key;
+    line >> key;
+    if(key == "format")
+    {
+        std::string format;
+        line >> format;
+        parser.binary = format != "ascii";
+        if(format == "binary_big_endian")
+            parser.failed = true;
+    }
+    else if(key == "element")
+    {
+        std::string name;
+        size_t count;
+        line >> name >> count;
+        parser.in_vertex_element = name == "vertex";
+        if(parser.in_vertex_element)
+            parser.num_vertices = count;
+    }
+    else if(key == "property" && parser.in_vertex_element)
+    {
+        std::string type, name;
+        line >> type >> name;
+        for(int a = 0; a < 3; a++)
+            if(name == std::string(1, (char)('x' + a)))
+            {
+                parser.xyz_property[a] = parser.num_properties;
+                parser.xyz_offset[a] = parser.record_size;
+                parser.xyz_size[a] = ply_type_size(type);
+            }
+        parser.record_size += ply_type_size(type);
+        parser.num_properties++;
+    }
+    else if(key == "end_header")
+    {
+        parser.in_header = false;
+        for(int a = 0; a < 3; a++)
+            if(parser.xyz_property[a] < 0 || (parser.binary && parser.xyz_size[a] != 4 && parser.xyz_size[a] != 8))
+                parser.failed = true;
+    }
+}
+
+void parse_ply_block(const std::string &block, PlyStreamParser &parser, std::vector<Vec3f> &pointcloud)
+{
+    if(parser.failed || (!parser.in_header && parser.num_read == parser.num_vertices))
+        return;
+
+    std::string data = parser.pending + block;
+    size_t pos = 0;
+
+    while(parser.in_header && !parser.failed)
+    {
+        size_t line_end = data.find('\n', pos);
+        if(line_end == std::string::npos)
+            break;
+        std::string line = data.substr(pos, line_end - pos);
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+        parse_ply_header_line(line, parser);
+        pos = line_end + 1;
+    }
+
+    if(!parser.in_header && !parser.failed && parser.binary)
+    {
+        for(; parser.num_read < parser.num_vertices && pos + parser.record_size <= data.size(); parser.num_read++)
+        {
+            float xyz[3];
+            for(int a = 0; a < 3; a++)
+            {
+                const char* value = data.data() + pos + parser.xyz_offset[a];
+                if(parser.xyz_size[a] == 4)
+                    memcpy(&xyz[a], value, sizeof(float));
+                else
+                {
+                    double tmp;
+                    memcpy(&tmp, value, sizeof(double));
+                    xyz[a] = tmp;
+                }
+            }
+            pointcloud.push_back(Vec3f((int)xyz[0], (int)xyz[1], (int)xyz[2]));
+            pos += parser.record_size;
+        }
+    }
+    else if(!parser.in_header && !parser.failed)
+    {
+        while(parser.num_read < parser.num_vertices)
+        {
+            size_t line_end = data.find('\n', pos);
+            if(line_end == std::string::npos)
+                break;
+
+            float xyz[3] = {0, 0, 0};
+            const char* cur = data.c_str() + pos;
+            for(int p = 0; p < parser.num_properties; p++)
+            {
+                char* next;
+                float value = strtof(cur, &next);
+                cur = next;
+                for(int a = 0; a < 3; a++)
+                    if(parser.xyz_property[a] == p)
+                        xyz[a] = value;
+            }
+            pointcloud.push_back(Vec3f((int)xyz[0], (int)xyz[1], (int)xyz[2]));
+            parser.num_read++;
+            pos = line_end + 1;
+        }
+    }
+
+    parser.pending = data.substr(std::min(pos, data.size()));
+}
+
+std::vector<Vec3f> get_pointcloud_from_gzip(std::string gz_path, bool is_ply)
+{
+    std::vector<Vec3f> pointcloud;
+
+    // Decompression runs on its own thread, parsing stays on this one
+    double inflate_ms = 0;
+    bool complete = false;
+    BoundedQueue<std::string> blocks(GZIP_QUEUE_SIZE);
+    std::thread inflater([&] { complete = inflate_blocks(gz_path, !is_ply, blocks, inflate_ms); });
+
+    TextParseState text_state;
+    PlyStreamParser ply_parser;
+    std::string block;
+    while(blocks.pop(block))
+    {
+        if(is_ply)
+            parse_ply_block(block, ply_parser, pointcloud);
+        else
+            parse_text_block(block, text_state, pointcloud);
+    }
+    inflater.join();
+
+    // A truncated or corrupt file is a failed read, not a smaller pointcloud
+    if(!complete)
+        pointcloud.clear();
+
+    return pointcloud;
+}
+// ===============================================================
+
+#endif
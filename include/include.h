@@ -11,38 +11,46 @@
 #include <cmath>
 #include <chrono>
 #include <map>
+#include <cstdint>
+#include <cctype>
+#include <algorithm>
 
-#include <opencv2/viz.hpp>
-#include "opencv2/opencv.hpp"
-#include "opencv2/imgcodecs.hpp"
-#include "opencv2/highgui.hpp"
-#include "opencv2/features2d.hpp"
-#include "opencv2/xfeatures2d.hpp"
-#include "opencv2/xfeatures2d/nonfree.hpp"
-#include "opencv2/core.hpp"
-#include "opencv2/imgproc.hpp"
+#include "vec3.h"
+#include "indexed_mesh.h"
 
 struct PointCloud 
 {
-    std::vector<cv::Point3f> vertices;
+    std::vector<Vec3f> vertices;
     std::vector<float> density;
 };
 
 struct Voxel
 {
-    std::vector<cv::Point3f> vertices;
+    std::vector<Vec3f> vertices;
     std::vector<float> density;
 };
 
 struct Tetrahedron
 {
-    std::vector<cv::Point3f> vertices;
+    std::vector<Vec3f> vertices;
     std::vector<float> density;
 };
 
+// edge_ids: exact ID of the grid edge each vertex lies on (see edge_crossing())
 struct Triangle
 {
-    std::vector<cv::Point3f> vertices;
+    std::vector<Vec3f> vertices;
+    std::vector<uint64_t> edge_ids;
+};
+
+// Regular grid of densities sampled at voxel corners
+// node (i, j, k) lies at origin + (i * dx, j * dy, k * dz)
+struct DensityGrid
+{
+    int nx, ny, nz;
+    float origin_x, origin_y, origin_z;
+    float dx, dy, dz;
+    std::vector<float> density;
 };
 
 #endif
\ No newline at end of file
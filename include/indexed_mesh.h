@@ -0,0 +1,32 @@
+#ifndef INDEXED_MESH
+#define INDEXED_MESH
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ===============================================================
+// Welded output mesh, the single copy extraction appends to and every writer reads
+// vertex v is (x[v], y[v], z[v]), face f is indices[3f .. 3f + 2]
+// edge_ids[v] is the grid edge of vertex v, only kept when asked for (see MeshBuilder)
+struct IndexedMesh
+{
+    std::vector<float> x, y, z;
+    std::vector<uint32_t> indices;
+    std::vector<uint64_t> edge_ids;
+
+    size_t num_vertices() const { return x.size(); }
+    size_t num_faces() const { return indices.size() / 3; }
+
+    void clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+        indices.clear();
+        edge_ids.clear();
+    }
+};
+// ===============================================================
+
+#endif
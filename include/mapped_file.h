@@ -0,0 +1,60 @@
+#ifndef MAPPED_FILE
+#define MAPPED_FILE
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include.h"
+
+// Read-only memory mapping of a whole file
+struct MappedFile
+{
+    const char* data = nullptr;
+    size_t size = 0;
+    int fd = -1;
+};
+
+bool map_file(const char* path, MappedFile &file)
+{
+    file.fd = open(path, O_RDONLY);
+    if(file.fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(file.fd, &st) != 0 || st.st_size == 0)
+    {
+        close(file.fd);
+        file.fd = -1;
+        return false;
+    }
+    file.size = st.st_size;
+
+    void* addr = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if(addr == MAP_FAILED)
+    {
+        close(file.fd);
+        file.fd = -1;
+        return false;
+    }
+    // Whole file is consumed front to back
+    madvise(addr, file.size, MADV_SEQUENTIAL);
+    file.data = (const char*)addr;
+
+    return true;
+}
+
+void unmap_file(MappedFile &file)
+{
+    if(file.data != nullptr)
+        munmap((void*)file.data, file.size);
+    if(file.fd >= 0)
+        close(file.fd);
+
+    file.data = nullptr;
+    file.size = 0;
+    file.fd = -1;
+}
+
+#endif
@@ -56,31 +56,41 @@
 
 #include "include.h"
 #include "parameters.h"
+#include "runtime_parameters.h"
+#include "mesh_builder.h"
 
-cv::Point3f interpolation(cv::Point3f pt1, cv::Point3f pt2, 
+Vec3f interpolation(Vec3f pt1, Vec3f pt2, 
                           float pt1_density, float pt2_density, float isovalue)
 {
+    // No crossing between equal densities
+    if(pt1_density == pt2_density)
+        return pt1;
+
     float mu = (isovalue - pt1_density) / (pt2_density - pt1_density);
 
     float inter_x = pt1.x + mu * (pt2.x - pt1.x);
     float inter_y = pt1.y + mu * (pt2.y - pt1.y);
     float inter_z = pt1.z + mu * (pt2.z - pt1.z);
 
-    return cv::Point3f(inter_x, inter_y, inter_z);
+    return Vec3f(inter_x, inter_y, inter_z);
 }
 
+// Grid offset of voxel corners v0 .. v7
+static const int VOXEL_CORNER_OFFSET[8][3] = {{0, 0, 1}, {1, 0, 1}, {1, 0, 0}, {0, 0, 0},
+                                              {0, 1, 1}, {1, 1, 1}, {1, 1, 0}, {0, 1, 0}};
+
 void init_voxel_vertices(PointCloud pointcloud, Voxel &voxel, 
                          float cur_x, float cur_y, float cur_z,
                          float diff_x, float diff_y, float diff_z)
 {
-    cv::Point3f v0(cur_x,          cur_y,          cur_z + diff_z);
-    cv::Point3f v1(cur_x + diff_x, cur_y,          cur_z + diff_z);
-    cv::Point3f v2(cur_x + diff_x, cur_y,          cur_z);
-    cv::Point3f v3(cur_x,          cur_y,          cur_z);
-    cv::Point3f v4(cur_x,          cur_y + diff_y, cur_z + diff_z);
-    cv::Point3f v5(cur_x + diff_x, cur_y + diff_y, cur_z + diff_z);
-    cv::Point3f v6(cur_x + diff_x, cur_y + diff_y, cur_z);
-    cv::Point3f v7(cur_x,          cur_y + diff_y, cur_z);
+    Vec3f v0(cur_x,          cur_y,          cur_z + diff_z);
+    Vec3f v1(cur_x + diff_x, cur_y,          cur_z + diff_z);
+    Vec3f v2(cur_x + diff_x, cur_y,          cur_z);
+    Vec3f v3(cur_x,          cur_y,          cur_z);
+    Vec3f v4(cur_x,          cur_y + diff_y, cur_z + diff_z);
+    Vec3f v5(cur_x + diff_x, cur_y + diff_y, cur_z + diff_z);
+    Vec3f v6(cur_x + diff_x, cur_y + diff_y, cur_z);
+    Vec3f v7(cur_x,          cur_y + diff_y, cur_z);
 
     voxel.vertices.push_back(v0);
     voxel.vertices.push_back(v1);
@@ -93,7 +103,7 @@ void init_voxel_vertices(PointCloud pointcloud, Voxel &voxel,
 
     for(int i = 0; i < voxel.vertices.size(); i++)
     {
-        cv::Point3f vertex = voxel.vertices[i];
+        Vec3f vertex = voxel.vertices[i];
         auto it = std::find(pointcloud.vertices.begin(), pointcloud.vertices.end(), vertex);
 
         if(it == pointcloud.vertices.end())
@@ -106,221 +116,214 @@ void init_voxel_vertices(PointCloud pointcloud, Voxel &voxel,
     }
 }
 
-void divide_into_six_triangles(Voxel cur_voxel, std::vector<Tetrahedron> &cur_six_tetrahedrons)
+
+// One voxel of a DensityGrid, corners v0 .. v7 laid out as in VOXEL_CORNER_OFFSET
+// Plain arrays, so marching a grid allocates nothing per voxel
+struct GridCell
 {
-    // Tetrahedron 1 (v3, v4, v5, v7) => p0 = v3 / p1 = v4 / p2 = v5 / p3 = v7
-    // Tetrahedron 2 (v3, v5, v6, v7) => p0 = v3 / p1 = v7 / p2 = v5 / p3 = v6
-    // Tetrahedron 3 (v0, v3, v4, v5) => p0 = v3 / p1 = v5 / p2 = v4 / p3 = v0
-    // Tetrahedron 4 (v0, v1, v3, v5) => p0 = v5 / p1 = v1 / p2 = v0 / p3 = v3
-    // Tetrahedron 5 (v1, v2, v3, v5) => p0 = v5 / p1 = v1 / p2 = v3 / p3 = v2
-    // Tetrahedron 6 (v2, v3, v5, v6) => p0 = v3 / p1 = v5 / p2 = v2 / p3 = v6
-
-    Tetrahedron t1;
-    t1.vertices.push_back(cur_voxel.vertices[3]);
-    t1.density.push_back(cur_voxel.density[3]);
-    t1.vertices.push_back(cur_voxel.vertices[4]);
-    t1.density.push_back(cur_voxel.density[4]);
-    t1.vertices.push_back(cur_voxel.vertices[5]);
-    t1.density.push_back(cur_voxel.density[5]);
-    t1.vertices.push_back(cur_voxel.vertices[7]);
-    t1.density.push_back(cur_voxel.density[7]);
-    cur_six_tetrahedrons.push_back(t1);
-
-    Tetrahedron t2;
-    t2.vertices.push_back(cur_voxel.vertices[3]);
-    t2.density.push_back(cur_voxel.density[3]);
-    t2.vertices.push_back(cur_voxel.vertices[7]);
-    t2.density.push_back(cur_voxel.density[7]);
-    t2.vertices.push_back(cur_voxel.vertices[5]);
-    t2.density.push_back(cur_voxel.density[5]);
-    t2.vertices.push_back(cur_voxel.vertices[6]);
-    t2.density.push_back(cur_voxel.density[6]);
-    cur_six_tetrahedrons.push_back(t2);
-
-    Tetrahedron t3;
-    t3.vertices.push_back(cur_voxel.vertices[3]);
-    t3.density.push_back(cur_voxel.density[3]);
-    t3.vertices.push_back(cur_voxel.vertices[5]);
-    t3.density.push_back(cur_voxel.density[5]);
-    t3.vertices.push_back(cur_voxel.vertices[4]);
-    t3.density.push_back(cur_voxel.density[4]);
-    t3.vertices.push_back(cur_voxel.vertices[0]);
-    t3.density.push_back(cur_voxel.density[0]);
-    cur_six_tetrahedrons.push_back(t3);
-
-    Tetrahedron t4;
-    t4.vertices.push_back(cur_voxel.vertices[5]);
-    t4.density.push_back(cur_voxel.density[5]);
-    t4.vertices.push_back(cur_voxel.vertices[1]);
-    t4.density.push_back(cur_voxel.density[1]);
-    t4.vertices.push_back(cur_voxel.vertices[0]);
-    t4.density.push_back(cur_voxel.density[0]);
-    t4.vertices.push_back(cur_voxel.vertices[3]);
-    t4.density.push_back(cur_voxel.density[3]);
-    cur_six_tetrahedrons.push_back(t4);
-    
-    Tetrahedron t5;
-    t5.vertices.push_back(cur_voxel.vertices[5]);
-    t5.density.push_back(cur_voxel.density[5]);
-    t5.vertices.push_back(cur_voxel.vertices[1]);
-    t5.density.push_back(cur_voxel.density[1]);
-    t5.vertices.push_back(cur_voxel.vertices[3]);
-    t5.density.push_back(cur_voxel.density[3]);
-    t5.vertices.push_back(cur_voxel.vertices[2]);
-    t5.density.push_back(cur_voxel.density[2]);
-    cur_six_tetrahedrons.push_back(t5);
-
-    Tetrahedron t6;
-    t6.vertices.push_back(cur_voxel.vertices[3]);
-    t6.density.push_back(cur_voxel.density[3]);
-    t6.vertices.push_back(cur_voxel.vertices[5]);
-    t6.density.push_back(cur_voxel.density[5]);
-    t6.vertices.push_back(cur_voxel.vertices[2]);
-    t6.density.push_back(cur_voxel.density[2]);
-    t6.vertices.push_back(cur_voxel.vertices[6]);
-    t6.density.push_back(cur_voxel.density[6]);
-    cur_six_tetrahedrons.push_back(t6);
-}
+    Vec3f vertices[8];
+    float density[8];
+    uint64_t nodes[8];
+};
 
-void get_vertice_density(std::vector<Tetrahedron> cur_six_tetrahedrons, std::vector<std::array<int, 6>> &cur_six_edges_rule)
+void load_grid_cell(const DensityGrid &grid, GridCell &cell, int i, int j, int k)
 {
-    for(int t = 0; t < cur_six_tetrahedrons.size(); t++)
+    for(int c = 0; c < 8; c++)
     {
-        Tetrahedron cur_tetrahedron = cur_six_tetrahedrons[t];
-
-        bool p0_value = false;
-        bool p1_value = false;
-        bool p2_value = false;
-        bool p3_value = false;
-
-        if(cur_tetrahedron.density[0] < ISOVALUE)
-            p0_value = true;
-        if(cur_tetrahedron.density[1] < ISOVALUE)
-            p1_value = true;
-        if(cur_tetrahedron.density[2] < ISOVALUE)
-            p2_value = true;
-        if(cur_tetrahedron.density[3] < ISOVALUE)
-            p3_value = true;
-
-        std::array<int, 6> vertices_density;
-        if(p0_value == false && p1_value == false && p2_value == false && p3_value == false)
-            vertices_density = std::array<int, 6>{0, 0, 0, 0, 0, 0};
-        else if(p0_value == false && p1_value == false && p2_value == false && p3_value == true)
-            vertices_density = std::array<int, 6>{0, 0, 1, 0, 1, 1};
-        else if(p0_value == false && p1_value == false && p2_value == true && p3_value == false)
-            vertices_density = std::array<int, 6>{0, 1, 0, 1, 1, 0};
-        else if(p0_value == false && p1_value == false && p2_value == true && p3_value == true)
-            vertices_density = std::array<int, 6>{0, 1, 1, 1, 0, 1};
-        else if(p0_value == false && p1_value == true && p2_value == false && p3_value == false)
-            vertices_density = std::array<int, 6>{1, 0, 0, 1, 0, 1};
-        else if(p0_value == false && p1_value == true && p2_value == false && p3_value == true)
-            vertices_density = std::array<int, 6>{1, 0, 1, 1, 1, 0};
-        else if(p0_value == false && p1_value == true && p2_value == true && p3_value == false)
-            vertices_density = std::array<int, 6>{1, 1, 0, 0, 1, 1};
-        else if(p0_value == false && p1_value == true && p2_value == true && p3_value == true)
-            vertices_density = std::array<int, 6>{1, 1, 1, 0, 0, 0};
-        else if(p0_value == true && p1_value == false && p2_value == false && p3_value == false)
-            vertices_density = std::array<int, 6>{1, 1, 1, 0, 0, 0};
-        else if(p0_value == true && p1_value == false && p2_value == false && p3_value == true)
-            vertices_density = std::array<int, 6>{1, 1, 0, 0, 1, 1};
-        else if(p0_value == true && p1_value == false && p2_value == true && p3_value == false)
-            vertices_density = std::array<int, 6>{1, 0, 1, 1, 1, 0};
-        else if(p0_value == true && p1_value == false && p2_value == true && p3_value == true)
-            vertices_density = std::array<int, 6>{1, 0, 0, 1, 0, 1};
-        else if(p0_value == true && p1_value == true && p2_value == false && p3_value == false)
-            vertices_density = std::array<int, 6>{0, 1, 1, 1, 0, 1};
-        else if(p0_value == true && p1_value == true && p2_value == false && p3_value == true)
-            vertices_density = std::array<int, 6>{0, 1, 0, 1, 1, 0};
-        else if(p0_value == true && p1_value == true && p2_value == true && p3_value == false)
-            vertices_density = std::array<int, 6>{0, 0, 1, 0, 1, 1};
-        else if(p0_value == true && p1_value == true && p2_value == true && p3_value == true)
-            vertices_density = std::array<int, 6>{0, 0, 0, 0, 0, 0};
-
-        cur_six_edges_rule.push_back(vertices_density);
+        int ci = i + VOXEL_CORNER_OFFSET[c][0];
+        int cj = j + VOXEL_CORNER_OFFSET[c][1];
+        int ck = k + VOXEL_CORNER_OFFSET[c][2];
+        size_t node = ((size_t)ck * grid.ny + cj) * grid.nx + ci;
+
+        cell.vertices[c] = Vec3f(grid.origin_x + ci * grid.dx,
+                                       grid.origin_y + cj * grid.dy,
+                                       grid.origin_z + ck * grid.dz);
+        cell.density[c] = grid.density[node];
+        cell.nodes[c] = node;
     }
 }
 
-void make_triangle(std::vector<Triangle> &triangles, std::vector<Tetrahedron> cur_six_tetrahedrons, std::vector<std::array<int, 6>> cur_six_edges_rule)
+// Voxel corners of the six tetrahedrons, as p0 .. p3 of the table above
+// Tetrahedron 1 (v3, v4, v5, v7) => p0 = v3 / p1 = v4 / p2 = v5 / p3 = v7
+// Tetrahedron 2 (v3, v5, v6, v7) => p0 = v3 / p1 = v7 / p2 = v5 / p3 = v6
+// Tetrahedron 3 (v0, v3, v4, v5) => p0 = v3 / p1 = v5 / p2 = v4 / p3 = v0
+// Tetrahedron 4 (v0, v1, v3, v5) => p0 = v5 / p1 = v1 / p2 = v0 / p3 = v3
+// Tetrahedron 5 (v1, v2, v3, v5) => p0 = v5 / p1 = v1 / p2 = v3 / p3 = v2
+// Tetrahedron 6 (v2, v3, v5, v6) => p0 = v3 / p1 = v5 / p2 = v2 / p3 = v6
+static const int TETRAHEDRON_CORNERS[6][4] = {{3, 4, 5, 7}, {3, 7, 5, 6}, {3, 5, 4, 0},
+                                              {5, 1, 0, 3}, {5, 1, 3, 2}, {3, 5, 2, 6}};
+
+// Tetrahedron edges p01, p02, p03, p12, p23, p31
+static const int TETRAHEDRON_EDGES[6][2] = {{0, 1}, {0, 2}, {0, 3}, {1, 2}, {2, 3}, {3, 1}};
+
+// Triangles of each case (p0 .. p3 below the isovalue as bits 3 .. 0): count, then 3 edges each
+static const int TETRAHEDRON_CASE_TRIANGLES[16][7] = {
+    {0},                         // 0000
+    {1, 2, 4, 5},                // 0001: p03, p23, p31
+    {1, 1, 3, 4},                // 0010: p02, p12, p23
+    {2, 1, 2, 5, 1, 5, 3},       // 0011: p02, p03, p31 + p02, p31, p12
+    {1, 0, 3, 5},                // 0100: p01, p12, p31
+    {2, 0, 2, 4, 0, 3, 4},       // 0101: p01, p03, p23 + p01, p12, p23
+    {2, 0, 1, 5, 1, 4, 5},       // 0110: p01, p02, p31 + p02, p23, p31
+    {1, 0, 1, 2},                // 0111: p01, p02, p03
+    {1, 0, 1, 2},                // 1000
+    {2, 0, 1, 5, 1, 4, 5},       // 1001
+    {2, 0, 2, 4, 0, 3, 4},       // 1010
+    {1, 0, 3, 5},                // 1011
+    {2, 1, 2, 5, 1, 5, 3},       // 1100
+    {1, 1, 3, 4},                // 1101
+    {1, 2, 4, 5},                // 1110
+    {0}};                        // 1111
+
+// Crossing on the grid edge between voxel corners a and b, returns its exact ID:
+// lower grid node index * 32 + direction (-1 .. 1 per axis) to the other node
+// - always interpolated from the lower node, so every tetrahedron sharing the edge computes
+//   bit-identical coordinates
+// - a crossing within snap_threshold of the edge length from an end moves onto that grid
+//   corner and gets the corner's ID, node index * 32 (direction 0 is never an edge)
+uint64_t edge_crossing(const GridCell &cell, int a, int b, float isovalue, float snap_threshold, Vec3f &point)
 {
-    for(int t = 0; t < cur_six_tetrahedrons.size(); t++)
+    if(cell.nodes[b] < cell.nodes[a])
+        std::swap(a, b);
+
+    if(snap_threshold > 0 && cell.density[a] != cell.density[b])
     {
-        Tetrahedron cur_tetra = cur_six_tetrahedrons[t];
+        float mu = (isovalue - cell.density[a]) / (cell.density[b] - cell.density[a]);
+        int corner = mu <= snap_threshold ? a : (mu >= 1 - snap_threshold ? b : -1);
+        if(corner >= 0)
+        {
+            point = cell.vertices[corner];
+            return cell.nodes[corner] * 32;
+        }
+    }
+
+    point = interpolation(cell.vertices[a], cell.vertices[b], cell.density[a], cell.density[b], isovalue);
+    int direction = 0;
+    for(int axis = 0; axis < 3; axis++)
+        direction = direction * 3 + VOXEL_CORNER_OFFSET[b][axis] - VOXEL_CORNER_OFFSET[a][axis] + 1;
+    return cell.nodes[a] * 32 + direction;
+}
 
-        cv::Point3f p01 = interpolation(cur_tetra.vertices[0], cur_tetra.vertices[1], cur_tetra.density[0], cur_tetra.density[1], ISOVALUE);
-        cv::Point3f p02 = interpolation(cur_tetra.vertices[0], cur_tetra.vertices[2], cur_tetra.density[0], cur_tetra.density[2], ISOVALUE);
-        cv::Point3f p03 = interpolation(cur_tetra.vertices[0], cur_tetra.vertices[3], cur_tetra.density[0], cur_tetra.density[3], ISOVALUE);
-        cv::Point3f p12 = interpolation(cur_tetra.vertices[1], cur_tetra.vertices[2], cur_tetra.density[1], cur_tetra.density[2], ISOVALUE);
-        cv::Point3f p23 = interpolation(cur_tetra.vertices[2], cur_tetra.vertices[3], cur_tetra.density[2], cur_tetra.density[3], ISOVALUE);
-        cv::Point3f p31 = interpolation(cur_tetra.vertices[3], cur_tetra.vertices[1], cur_tetra.density[3], cur_tetra.density[1], ISOVALUE);
+// Six tetrahedrons of one voxel into a MeshBuilder or ConcurrentMeshBuilder
+// Crossings snapped to the same corner collapse a triangle, it is dropped right away
+template <typename Builder>
+void march_cell(const GridCell &cell, float isovalue, float snap_threshold, Builder &triangles)
+{
+    for(int t = 0; t < 6; t++)
+    {
+        const int* corners = TETRAHEDRON_CORNERS[t];
+        int cur_case = 0;
+        for(int p = 0; p < 4; p++)
+            cur_case = cur_case << 1 | (cell.density[corners[p]] < isovalue);
 
-        Triangle tri1, tri2;
-        if(cur_six_edges_rule[t] == std::array<int, 6>{0, 0, 0, 0, 0, 0})
+        const int* rule = TETRAHEDRON_CASE_TRIANGLES[cur_case];
+        if(rule[0] == 0)
             continue;
-        else if(cur_six_edges_rule[t] == std::array<int, 6>{0, 0, 1, 0, 1, 1})
-        {
-            tri1.vertices.push_back(p03);
-            tri1.vertices.push_back(p23);
-            tri1.vertices.push_back(p31);
-            triangles.push_back(tri1);
-        }
-        else if(cur_six_edges_rule[t] == std::array<int, 6>{0, 1, 0, 1, 1, 0})
-        {
-            tri1.vertices.push_back(p02);
-            tri1.vertices.push_back(p12);
-            tri1.vertices.push_back(p23);
-            triangles.push_back(tri1);
-        }
-        else if(cur_six_edges_rule[t] == std::array<int, 6>{0, 1, 1, 1, 0, 1})
-        {
-            tri1.vertices.push_back(p02);
-            tri1.vertices.push_back(p03);
-            tri1.vertices.push_back(p31);
-            triangles.push_back(tri1);
-
-            tri2.vertices.push_back(p02);
-            tri2.vertices.push_back(p31);
-            tri2.vertices.push_back(p12);
-            triangles.push_back(tri2);
-        }
-        else if(cur_six_edges_rule[t] == std::array<int, 6>{1, 0, 0, 1, 0, 1})
-        {
-            tri1.vertices.push_back(p01);
-            tri1.vertices.push_back(p12);
-            tri1.vertices.push_back(p31);
-            triangles.push_back(tri1);
-        }
-        else if(cur_six_edges_rule[t] == std::array<int, 6>{1, 0, 1, 1, 1, 0})
-        {
-            tri1.vertices.push_back(p01);
-            tri1.vertices.push_back(p03);
-            tri1.vertices.push_back(p23);
-            triangles.push_back(tri1);
-
-            tri2.vertices.push_back(p01);
-            tri2.vertices.push_back(p12);
-            tri2.vertices.push_back(p23);
-            triangles.push_back(tri2);
-        }
-        else if(cur_six_edges_rule[t] == std::array<int, 6>{1, 1, 0, 0, 1, 1})
-        {
-            tri1.vertices.push_back(p01);
-            tri1.vertices.push_back(p02);
-            tri1.vertices.push_back(p31);
-            triangles.push_back(tri1);
-
-            tri2.vertices.push_back(p02);
-            tri2.vertices.push_back(p23);
-            tri2.vertices.push_back(p31);
-            triangles.push_back(tri2);
-        }
-        else if(cur_six_edges_rule[t] == std::array<int, 6>{1, 1, 1, 0, 0, 0})
+
+        // Only the edges the case uses are interpolated
+        Vec3f points[6];
+        uint64_t ids[6];
+        bool crossed[6] = {false, false, false, false, false, false};
+        for(int n = 0; n < rule[0]; n++)
         {
-            tri1.vertices.push_back(p01);
-            tri1.vertices.push_back(p02);
-            tri1.vertices.push_back(p03);
-            triangles.push_back(tri1);
+            Vec3f tri_points[3];
+            uint64_t tri_ids[3];
+            for(int v = 0; v < 3; v++)
+            {
+                int e = rule[1 + 3 * n + v];
+                if(!crossed[e])
+                {
+                    ids[e] = edge_crossing(cell, corners[TETRAHEDRON_EDGES[e][0]], corners[TETRAHEDRON_EDGES[e][1]],
+                                           isovalue, snap_threshold, points[e]);
+                    crossed[e] = true;
+                }
+                tri_points[v] = points[e];
+                tri_ids[v] = ids[e];
+            }
+
+            if(tri_ids[0] == tri_ids[1] || tri_ids[1] == tri_ids[2] || tri_ids[2] == tri_ids[0])
+                continue;
+            triangles.add_triangle(tri_points, tri_ids);
         }
     }
 }
 
-#endif
\ No newline at end of file
+// March every voxel in [i_begin, i_end) x [j_begin, j_end) x [k_begin, k_end)
+// into a MeshBuilder or ConcurrentMeshBuilder
+template <typename Builder>
+void march_cells(const DensityGrid &grid, float isovalue, float snap_threshold, Builder &triangles,
+                 int i_begin, int i_end, int j_begin, int j_end, int k_begin, int k_end)
+{
+    GridCell cell;
+    for (int k = k_begin; k < k_end; k++)
+        for (int j = j_begin; j < j_end; j++)
+            for (int i = i_begin; i < i_end; i++)
+            {
+                load_grid_cell(grid, cell, i, j, k);
+                march_cell(cell, isovalue, snap_threshold, triangles);
+            }
+}
+
+// Same, at the run's isovalue (see runtime_parameters.h) and SNAP_THRESHOLD
+template <typename Builder>
+void march_cells(const DensityGrid &grid, Builder &triangles,
+                 int i_begin, int i_end, int j_begin, int j_end, int k_begin, int k_end)
+{
+    march_cells(grid, runtime_parameters().isovalue, SNAP_THRESHOLD, triangles, i_begin, i_end, j_begin, j_end, k_begin, k_end);
+}
+
+// Grid edge directions of the six tetrahedrons, from the lower node of each edge
+static const int TETRAHEDRON_EDGE_OFFSET[7][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {1, 1, 0},
+                                                  {1, 0, 1}, {0, 1, 1}, {1, 1, 1}};
+
+// Edges with one node below isovalue and the other not in z layers [k_begin, k_end):
+// at most one output vertex each
+size_t count_crossing_edges(const DensityGrid &grid, float isovalue, int k_begin, int k_end)
+{
+    size_t count = 0;
+    for (int k = k_begin; k < k_end; k++)
+        for (int j = 0; j < grid.ny; j++)
+            for (int i = 0; i < grid.nx; i++)
+            {
+                bool below = grid.density[((size_t)k * grid.ny + j) * grid.nx + i] < isovalue;
+                for (int e = 0; e < 7; e++)
+                {
+                    int ci = i + TETRAHEDRON_EDGE_OFFSET[e][0];
+                    int cj = j + TETRAHEDRON_EDGE_OFFSET[e][1];
+                    int ck = k + TETRAHEDRON_EDGE_OFFSET[e][2];
+                    if (ci < grid.nx && cj < grid.ny && ck < grid.nz &&
+                        below != (grid.density[((size_t)ck * grid.ny + cj) * grid.nx + ci] < isovalue))
+                        count++;
+                }
+            }
+    return count;
+}
+
+// Triangles the case table gives for the voxels of z layers [k_begin, k_end): the faces
+// marched there, before triangles collapsed by snapping are dropped
+size_t count_case_triangles(const DensityGrid &grid, float isovalue, int k_begin, int k_end)
+{
+    size_t count = 0;
+    for (int k = k_begin; k < k_end; k++)
+        for (int j = 0; j + 1 < grid.ny; j++)
+            for (int i = 0; i + 1 < grid.nx; i++)
+            {
+                bool below[8];
+                for (int c = 0; c < 8; c++)
+                {
+                    size_t node = ((size_t)(k + VOXEL_CORNER_OFFSET[c][2]) * grid.ny + j + VOXEL_CORNER_OFFSET[c][1]) * grid.nx
+                                + i + VOXEL_CORNER_OFFSET[c][0];
+                    below[c] = grid.density[node] < isovalue;
+                }
+                for (int t = 0; t < 6; t++)
+                {
+                    int cur_case = 0;
+                    for (int p = 0; p < 4; p++)
+                        cur_case = cur_case << 1 | below[TETRAHEDRON_CORNERS[t][p]];
+                    count += TETRAHEDRON_CASE_TRIANGLES[cur_case][0];
+                }
+            }
+    return count;
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef MESH_BUILDER
+#define MESH_BUILDER
+
+#include "include.h"
+#include "parameters.h"
+#include "vertex_hash.h"
+#include "concurrent_weld.h"
+
+// ===============================================================
+// Welds marched triangles straight into an IndexedMesh, vertices numbered by first use
+// - vertices are welded on the grid edge IDs they were marched from
+// - the edge ID table can be the caller's, kept across meshes to reuse its slots (clear() it first)
+class MeshBuilder
+{
+public:
+    MeshBuilder(IndexedMesh &mesh, bool keep_edge_ids = false)
+        : MeshBuilder(mesh, ownEdgeMap, keep_edge_ids) {}
+
+    MeshBuilder(IndexedMesh &mesh, EdgeHashMap &edgeMap, bool keep_edge_ids)
+        : mesh(mesh), keep_edge_ids(keep_edge_ids), edgeMap(edgeMap) {}
+
+    void add_triangle(const Vec3f vertices[3], const uint64_t edge_ids[3])
+    {
+        for (int v = 0; v < 3; v++)
+        {
+            bool inserted;
+            int index = edgeMap.find_or_insert(edge_ids[v], inserted);
+            if (inserted)
+            {
+                mesh.x.push_back(vertices[v].x);
+                mesh.y.push_back(vertices[v].y);
+                mesh.z.push_back(vertices[v].z);
+                if (keep_edge_ids)
+                    mesh.edge_ids.push_back(edge_ids[v]);
+            }
+            mesh.indices.push_back(index);
+        }
+    }
+
+private:
+    IndexedMesh &mesh;
+    bool keep_edge_ids;
+    EdgeHashMap ownEdgeMap;
+    EdgeHashMap &edgeMap;
+};
+
+// One of the threads marching a grid into a shared mesh, welding on edge IDs through a ConcurrentEdgeMap
+// - mesh.x / y / z must already hold every vertex the map can number (see count_crossing_edges()),
+//   a new vertex is stored at its index, which no other thread writes
+// - faces go to this thread's own range of indices, in marching order; the range must have room
+//   for every face (see count_case_triangles())
+// - edge IDs are stored too if mesh.edge_ids is sized like mesh.x
+class ConcurrentMeshBuilder
+{
+public:
+    ConcurrentMeshBuilder(IndexedMesh &mesh, ConcurrentEdgeMap &edgeMap, uint32_t* indices)
+        : mesh(mesh), edgeMap(edgeMap), indices(indices) {}
+
+    size_t num_indices() const { return num_written; }
+
+    void add_triangle(const Vec3f vertices[3], const uint64_t edge_ids[3])
+    {
+        for (int v = 0; v < 3; v++)
+        {
+            bool inserted;
+            int index = edgeMap.find_or_insert(edge_ids[v], inserted);
+            if (inserted)
+            {
+                mesh.x[index] = vertices[v].x;
+                mesh.y[index] = vertices[v].y;
+                mesh.z[index] = vertices[v].z;
+                if (!mesh.edge_ids.empty())
+                    mesh.edge_ids[index] = edge_ids[v];
+            }
+            indices[num_written++] = index;
+        }
+    }
+
+private:
+    IndexedMesh &mesh;
+    ConcurrentEdgeMap &edgeMap;
+    uint32_t* indices;
+    size_t num_written = 0;
+};
+// ===============================================================
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef MESH_CLEANUP
+#define MESH_CLEANUP
+
+#include <cmath>
+#include <vector>
+
+#include "indexed_mesh.h"
+#include "vertex_hash.h"
+#include "mesh_optimize.h"
+
+// ===============================================================
+// Cleanup of an IndexedMesh, linear in vertices and faces
+// - vertices closer than tolerance are welded; a uniform grid of tolerance sized cells is
+//   hashed (EdgeHashMap on the cell coordinates), each vertex is compared with the vertices
+//   kept so far in its 27 neighbouring cells
+// - faces that collapse to an edge or point, faces with (almost) no area and repeated faces
+//   (same three vertices in any order) are dropped, then unused vertices
+struct MeshCleanupStats
+{
+    size_t welded_vertices = 0;
+    size_t collapsed_faces = 0;
+    size_t zero_area_faces = 0;
+    size_t duplicate_faces = 0;
+};
+
+inline uint64_t cell_key(int64_t cx, int64_t cy, int64_t cz)
+{
+    // Distinct cells may share a key, they then share a list and only cost extra distance checks
+    return (uint64_t)cx * 0x9E3779B97F4A7C15ULL ^ (uint64_t)cy * 0xC2B2AE3D27D4EB4FULL ^ (uint64_t)cz * 0x165667B19E3779F9ULL;
+}
+
+// Returns the number of vertices merged into an earlier one, indices are remapped
+size_t weld_vertices_within(IndexedMesh &mesh, float tolerance)
+{
+    size_t num_vertices = mesh.num_vertices();
+    if(num_vertices == 0 || !(tolerance > 0))
+        return 0;
+
+    // Kept vertices of each cell as linked lists: cell_head[cell] -> next_in_cell[v] -> ...
+    EdgeHashMap cellMap(num_vertices);
+    std::vector<uint32_t> cell_head;
+    std::vector<uint32_t> next_in_cell(num_vertices, UINT32_MAX);
+    std::vector<uint32_t> remap(num_vertices);
+    float inv_cell = 1.0f / tolerance;
+    float tolerance_sq = tolerance * tolerance;
+
+    IndexedMesh welded;
+    for(size_t v = 0; v < num_vertices; v++)
+    {
+        int64_t cx = (int64_t)std::floor(mesh.x[v] * inv_cell);
+        int64_t cy = (int64_t)std::floor(mesh.y[v] * inv_cell);
+        int64_t cz = (int64_t)std::floor(mesh.z[v] * inv_cell);
+
+        uint32_t match = UINT32_MAX;
+        for(int dz = -1; dz <= 1 && match == UINT32_MAX; dz++)
+            for(int dy = -1; dy <= 1 && match == UINT32_MAX; dy++)
+                for(int dx = -1; dx <= 1 && match == UINT32_MAX; dx++)
+                {
+                    int cell = cellMap.find(cell_key(cx + dx, cy + dy, cz + dz));
+                    if(cell < 0)
+                        continue;
+                    for(uint32_t k = cell_head[cell]; k != UINT32_MAX; k = next_in_cell[k])
+                    {
+                        float ex = welded.x[k] - mesh.x[v];
+                        float ey = welded.y[k] - mesh.y[v];
+                        float ez = welded.z[k] - mesh.z[v];
+                        if(ex * ex + ey * ey + ez * ez <= tolerance_sq)
+                        {
+                            match = k;
+                            break;
+                        }
+                    }
+                }
+
+        if(match != UINT32_MAX)
+        {
+            remap[v] = match;
+            continue;
+        }
+
+        uint32_t k = welded.num_vertices();
+        bool inserted;
+        int cell = cellMap.find_or_insert(cell_key(cx, cy, cz), inserted);
+        if(inserted)
+            cell_head.push_back(UINT32_MAX);
+        next_in_cell[k] = cell_head[cell];
+        cell_head[cell] = k;
+        remap[v] = k;
+        welded.x.push_back(mesh.x[v]);
+        welded.y.push_back(mesh.y[v]);
+        welded.z.push_back(mesh.z[v]);
+        if(!mesh.edge_ids.empty())
+            welded.edge_ids.push_back(mesh.edge_ids[v]);
+    }
+
+    for(uint32_t &index: mesh.indices)
+        index = remap[index];
+    size_t num_welded = num_vertices - welded.num_vertices();
+    mesh.x.swap(welded.x);
+    mesh.y.swap(welded.y);
+    mesh.z.swap(welded.z);
+    mesh.edge_ids.swap(welded.edge_ids);
+    return num_welded;
+}
+
+// Set of faces by their sorted vertex indices, open addressing like vertex_hash.h
+// Grows when half full; clear() keeps the capacity for the next mesh
+class FaceHashSet
+{
+public:
+    explicit FaceHashSet(size_t expected_size = 0) { clear(expected_size); }
+
+    // Empty set with room for expected_size faces before growing
+    void clear(size_t expected_size = 0)
+    {
+        size_t capacity = 16;
+        while(capacity < 2 * expected_size)
+            capacity <<= 1;
+        Slot empty = {UINT32_MAX, UINT32_MAX, UINT32_MAX};
+        if(slots.size() < capacity)
+            slots.resize(capacity);
+        std::fill(slots.begin(), slots.end(), empty);
+        count = 0;
+    }
+
+    // False if the face was added before
+    bool insert(uint32_t a, uint32_t b, uint32_t c)
+    {
+        if(a > b)
+            std::swap(a, b);
+        if(b > c)
+            std::swap(b, c);
+        if(a > b)
+            std::swap(a, b);
+
+        if(2 * (count + 1) > slots.size())
+            grow();
+        Slot face = {a, b, c};
+        if(!insert_slot(face))
+            return false;
+        count++;
+        return true;
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t a, b, c;
+    };
+
+    bool insert_slot(const Slot &face)
+    {
+        uint64_t h = ((uint64_t)face.a << 32 | face.b) * 0x9E3779B97F4A7C15ULL ^ (uint64_t)face.c * 0xC2B2AE3D27D4EB4FULL;
+        h ^= h >> 29;
+        size_t mask = slots.size() - 1;
+        for(size_t s = h & mask; ; s = (s + 1) & mask)
+        {
+            Slot &slot = slots[s];
+            if(slot.a == UINT32_MAX)
+            {
+                slot = face;
+                return true;
+            }
+            if(slot.a == face.a && slot.b == face.b && slot.c == face.c)
+                return false;
+        }
+    }
+
+    void grow()
+    {
+        Slot empty = {UINT32_MAX, UINT32_MAX, UINT32_MAX};
+        std::vector<Slot> old(2 * slots.size(), empty);
+        old.swap(slots);
+        for(const Slot &slot: old)
+            if(slot.a != UINT32_MAX)
+                insert_slot(slot);
+    }
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+};
+
+// Drops faces with the same three vertices as an earlier face (any order), keeps the order of
+// the rest; returns the number dropped. No vertex loses its last face, so vertices stay as they are
+size_t remove_duplicate_faces(IndexedMesh &mesh, FaceHashSet &faceSet)
+{
+    faceSet.clear(mesh.num_faces());
+    size_t kept = 0;
+    for(size_t f = 0; f < mesh.num_faces(); f++)
+    {
+        uint32_t a = mesh.indices[3 * f], b = mesh.indices[3 * f + 1], c = mesh.indices[3 * f + 2];
+        if(!faceSet.insert(a, b, c))
+            continue;
+        mesh.indices[3 * kept] = a;
+        mesh.indices[3 * kept + 1] = b;
+        mesh.indices[3 * kept + 2] = c;
+        kept++;
+    }
+    size_t num_removed = mesh.num_faces() - kept;
+    mesh.indices.resize(3 * kept);
+    return num_removed;
+}
+
+// Faces whose doubled area is at most tolerance^2 count as zero area
+void clean_mesh(IndexedMesh &mesh, float tolerance, MeshCleanupStats &stats)
+{
+    stats = MeshCleanupStats();
+    stats.welded_vertices = weld_vertices_within(mesh, tolerance);
+
+    float max_doubled_area_sq = tolerance * tolerance * tolerance * tolerance;
+    FaceHashSet faceSet(mesh.num_faces());
+    size_t kept = 0;
+    for(size_t f = 0; f < mesh.num_faces(); f++)
+    {
+        uint32_t a = mesh.indices[3 * f], b = mesh.indices[3 * f + 1], c = mesh.indices[3 * f + 2];
+        if(a == b || b == c || c == a)
+        {
+            stats.collapsed_faces++;
+            continue;
+        }
+
+        float e1[3] = {mesh.x[b] - mesh.x[a], mesh.y[b] - mesh.y[a], mesh.z[b] - mesh.z[a]};
+        float e2[3] = {mesh.x[c] - mesh.x[a], mesh.y[c] - mesh.y[a], mesh.z[c] - mesh.z[a]};
+        float nx = e1[1] * e2[2] - e1[2] * e2[1];
+        float ny = e1[2] * e2[0] - e1[0] * e2[2];
+        float nz = e1[0] * e2[1] - e1[1] * e2[0];
+        if(nx * nx + ny * ny + nz * nz <= max_doubled_area_sq)
+        {
+            stats.zero_area_faces++;
+            continue;
+        }
+
+        if(!faceSet.insert(a, b, c))
+        {
+            stats.duplicate_faces++;
+            continue;
+        }
+
+        mesh.indices[3 * kept] = a;
+        mesh.indices[3 * kept + 1] = b;
+        mesh.indices[3 * kept + 2] = c;
+        kept++;
+    }
+    mesh.indices.resize(3 * kept);
+
+    // Drops vertices only dropped faces used
+    reorder_vertices_by_first_use(mesh);
+}
+// ===============================================================
+
+#endif
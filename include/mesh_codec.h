@@ -0,0 +1,233 @@
+#ifndef MESH_CODEC
+#define MESH_CODEC
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <zlib.h>
+
+#include "indexed_mesh.h"
+
+// ===============================================================
+// Compact mesh encoding (.mtz)
+// - positions are quantised on a lattice aligned with the density grid
+//   (grid spacing / 2^fraction_bits), every marched vertex sits on a grid edge
+//   at a fixed fraction, so this is (nearly) lossless
+// - vertices are delta coded along index order (first use order of the sweep)
+// - each face corner is coded relative to the next unseen vertex index, so
+//   new vertices cost 0 and shared vertices of neighbouring faces stay small
+// - both streams are zigzag varints, then deflated with zlib
+struct MeshCodecHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t num_vertices;
+    uint64_t num_faces;
+    float origin[3];
+    float step[3];
+    uint64_t vertex_stream_size;
+    uint64_t index_stream_size;
+    uint64_t vertex_raw_size;
+    uint64_t index_raw_size;
+};
+
+static const char MESH_CODEC_MAGIC[4] = {'M', 'T', 'M', 'Z'};
+static const uint32_t MESH_CODEC_VERSION = 1;
+
+inline uint64_t zigzag_encode(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+inline void put_varint(std::vector<uint8_t> &stream, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        stream.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    stream.push_back((uint8_t)value);
+}
+
+inline bool get_varint(const uint8_t* &cur, const uint8_t* end, uint64_t &value)
+{
+    value = 0;
+    for(int shift = 0; shift < 64 && cur < end; shift += 7)
+    {
+        uint8_t byte = *cur++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// origin / step define the quantisation lattice, returns false if deflate fails
+bool encode_mesh(const IndexedMesh &mesh, const float origin[3], const float step[3], std::vector<uint8_t> &encoded)
+{
+    const std::vector<float>* xyz[3] = {&mesh.x, &mesh.y, &mesh.z};
+    const std::vector<uint32_t> &indices = mesh.indices;
+
+    MeshCodecHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CODEC_MAGIC, sizeof(header.magic));
+    header.version = MESH_CODEC_VERSION;
+    header.num_vertices = mesh.num_vertices();
+    header.num_faces = indices.size() / 3;
+    for(int a = 0; a < 3; a++)
+    {
+        header.origin[a] = origin[a];
+        header.step[a] = step[a];
+    }
+
+    // Vertex stream: lattice deltas along index order
+    std::vector<uint8_t> vertex_stream;
+    vertex_stream.reserve(3 * mesh.num_vertices());
+    int64_t prev[3] = {0, 0, 0};
+    for(size_t v = 0; v < header.num_vertices; v++)
+        for(int a = 0; a < 3; a++)
+        {
+            int64_t q = (int64_t)std::llround(((*xyz[a])[v] - origin[a]) / step[a]);
+            put_varint(vertex_stream, zigzag_encode(q - prev[a]));
+            prev[a] = q;
+        }
+
+    // Index stream: distance back from the next unseen index (0 = new vertex)
+    std::vector<uint8_t> index_stream;
+    index_stream.reserve(indices.size());
+    int64_t next_new = 0;
+    for(size_t i = 0; i < indices.size(); i++)
+    {
+        put_varint(index_stream, zigzag_encode(next_new - (int64_t)indices[i]));
+        next_new = std::max(next_new, (int64_t)indices[i] + 1);
+    }
+
+    header.vertex_raw_size = vertex_stream.size();
+    header.index_raw_size = index_stream.size();
+
+    std::vector<uint8_t> vertex_deflated(compressBound(vertex_stream.size()));
+    std::vector<uint8_t> index_deflated(compressBound(index_stream.size()));
+    uLongf vertex_size = vertex_deflated.size();
+    uLongf index_size = index_deflated.size();
+    if(compress2(vertex_deflated.data(), &vertex_size, vertex_stream.data(), vertex_stream.size(), Z_BEST_SPEED) != Z_OK ||
+       compress2(index_deflated.data(), &index_size, index_stream.data(), index_stream.size(), Z_BEST_SPEED) != Z_OK)
+        return false;
+    header.vertex_stream_size = vertex_size;
+    header.index_stream_size = index_size;
+
+    encoded.resize(sizeof(header) + vertex_size + index_size);
+    memcpy(encoded.data(), &header, sizeof(header));
+    memcpy(encoded.data() + sizeof(header), vertex_deflated.data(), vertex_size);
+    memcpy(encoded.data() + sizeof(header) + vertex_size, index_deflated.data(), index_size);
+    return true;
+}
+
+// Largest ratio deflate reaches (zlib technical details: 1032:1)
+static const uint64_t DEFLATE_MAX_RATIO = 1032;
+
+// Header sizes and counts consistent with each other and with the data size, checked before
+// anything is allocated from them: every coordinate and corner is one varint of 1 to 10 bytes,
+// and a stream can't inflate past DEFLATE_MAX_RATIO times its compressed size
+bool valid_codec_header(const MeshCodecHeader &header, size_t size)
+{
+    uint64_t payload = size - sizeof(header);
+    return memcmp(header.magic, MESH_CODEC_MAGIC, sizeof(header.magic)) == 0 &&
+           header.version == MESH_CODEC_VERSION &&
+           header.vertex_stream_size <= payload && header.index_stream_size == payload - header.vertex_stream_size &&
+           header.num_vertices <= UINT32_MAX && header.num_faces <= UINT32_MAX &&
+           header.vertex_raw_size >= 3 * header.num_vertices && header.vertex_raw_size <= 30 * header.num_vertices &&
+           header.index_raw_size >= 3 * header.num_faces && header.index_raw_size <= 30 * header.num_faces &&
+           header.vertex_raw_size <= DEFLATE_MAX_RATIO * header.vertex_stream_size &&
+           header.index_raw_size <= DEFLATE_MAX_RATIO * header.index_stream_size;
+}
+
+bool decode_mesh(const uint8_t* data, size_t size, IndexedMesh &mesh)
+{
+    std::vector<float>* xyz[3] = {&mesh.x, &mesh.y, &mesh.z};
+    std::vector<uint32_t> &indices = mesh.indices;
+
+    MeshCodecHeader header;
+    if(size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if(!valid_codec_header(header, size))
+        return false;
+
+    std::vector<uint8_t> vertex_stream(header.vertex_raw_size);
+    std::vector<uint8_t> index_stream(header.index_raw_size);
+    uLongf vertex_size = vertex_stream.size();
+    uLongf index_size = index_stream.size();
+    if(uncompress(vertex_stream.data(), &vertex_size, data + sizeof(header), header.vertex_stream_size) != Z_OK ||
+       uncompress(index_stream.data(), &index_size, data + sizeof(header) + header.vertex_stream_size, header.index_stream_size) != Z_OK ||
+       vertex_size != header.vertex_raw_size || index_size != header.index_raw_size)
+        return false;
+
+    mesh.clear();
+    for(int a = 0; a < 3; a++)
+        xyz[a]->resize(header.num_vertices);
+    const uint8_t* cur = vertex_stream.data();
+    const uint8_t* end = cur + vertex_stream.size();
+    int64_t prev[3] = {0, 0, 0};
+    for(size_t v = 0; v < header.num_vertices; v++)
+        for(int a = 0; a < 3; a++)
+        {
+            uint64_t delta;
+            if(!get_varint(cur, end, delta))
+                return false;
+            prev[a] += zigzag_decode(delta);
+            (*xyz[a])[v] = header.origin[a] + prev[a] * header.step[a];
+        }
+
+    indices.resize(3 * header.num_faces);
+    cur = index_stream.data();
+    end = cur + index_stream.size();
+    int64_t next_new = 0;
+    for(size_t i = 0; i < indices.size(); i++)
+    {
+        uint64_t code;
+        if(!get_varint(cur, end, code))
+            return false;
+        int64_t index = next_new - zigzag_decode(code);
+        if(index < 0 || (uint64_t)index >= header.num_vertices)
+            return false;
+        indices[i] = index;
+        next_new = std::max(next_new, index + 1);
+    }
+
+    return true;
+}
+
+bool write_encoded_mesh(const std::vector<uint8_t> &encoded, const std::string &path)
+{
+    FILE* outputFile = fopen(path.c_str(), "wb");
+    if(outputFile == nullptr)
+        return false;
+    bool ok = fwrite(encoded.data(), 1, encoded.size(), outputFile) == encoded.size();
+    return (fclose(outputFile) == 0) && ok;
+}
+
+bool read_encoded_mesh(const std::string &path, std::vector<uint8_t> &encoded)
+{
+    FILE* inputFile = fopen(path.c_str(), "rb");
+    if(inputFile == nullptr)
+        return false;
+    fseek(inputFile, 0, SEEK_END);
+    long size = ftell(inputFile);
+    fseek(inputFile, 0, SEEK_SET);
+    encoded.resize(size > 0 ? size : 0);
+    bool ok = size > 0 && fread(encoded.data(), 1, encoded.size(), inputFile) == encoded.size();
+    fclose(inputFile);
+    return ok;
+}
+// ===============================================================
+
+#endif
@@ -0,0 +1,323 @@
+#ifndef MESH_DAEMON
+#define MESH_DAEMON
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "include.h"
+#include "parameters.h"
+#include "batch.h"
+#include "grid_cache.h"
+#include "daemon_protocol.h"
+#include "thread_pool.h"
+
+// ===============================================================
+// Long-running meshing daemon (protocol in daemon_protocol.h)
+// - connections are served on one ThreadPool; like batch mode each worker keeps a serial
+//   MarchingTetrahedra and output mesh from one job to the next
+// - density grids of input files stay in memory per NUM_VOXEL (DAEMON_GRID_CACHE_ENTRIES, least
+//   recently used dropped first), checked against the file's size and modification time
+// - connections idle for DAEMON_RECV_TIMEOUT_MS, or not reading a reply for DAEMON_SEND_TIMEOUT_MS,
+//   are dropped, so stuck clients free their worker
+// - jobs get the same cleanup / decimation / vertex cache optimisation / Morton order as batch mode
+class DensityGridMemoryCache
+{
+public:
+    explicit DensityGridMemoryCache(size_t max_entries) : max_entries(max_entries) {}
+
+    std::shared_ptr<const DensityGrid> find(const std::string &path, int num_voxel)
+    {
+        uint64_t size;
+        int64_t mtime;
+        if(!get_source_stamp(path, size, mtime))
+            return nullptr;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto it = entries.begin(); it != entries.end(); ++it)
+            if(it->path == path && it->num_voxel == num_voxel)
+            {
+                if(it->size != size || it->mtime != mtime)
+                {
+                    entries.erase(it);
+                    return nullptr;
+                }
+                entries.splice(entries.begin(), entries, it);
+                return it->grid;
+            }
+        return nullptr;
+    }
+
+    void insert(const std::string &path, int num_voxel, std::shared_ptr<const DensityGrid> grid)
+    {
+        Entry entry;
+        entry.path = path;
+        entry.num_voxel = num_voxel;
+        entry.grid = grid;
+        if(max_entries == 0 || !get_source_stamp(path, entry.size, entry.mtime))
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto it = entries.begin(); it != entries.end(); ++it)
+            if(it->path == path && it->num_voxel == num_voxel)
+            {
+                entries.erase(it);
+                break;
+            }
+        entries.push_front(entry);
+        if(entries.size() > max_entries)
+            entries.pop_back();
+    }
+
+private:
+    struct Entry
+    {
+        std::string path;
+        int num_voxel;
+        uint64_t size;
+        int64_t mtime;
+        std::shared_ptr<const DensityGrid> grid;
+    };
+
+    size_t max_entries;
+    std::mutex mutex;
+    std::list<Entry> entries;
+};
+
+class MeshDaemon
+{
+public:
+    MeshDaemon(const std::string &socket_path, int num_threads)
+        : socket_path(socket_path), pool(num_threads), grid_cache(DAEMON_GRID_CACHE_ENTRIES) {}
+
+    ~MeshDaemon()
+    {
+        if(listen_fd >= 0)
+        {
+            close(listen_fd);
+            unlink(socket_path.c_str());
+        }
+    }
+
+    int num_threads() const { return pool.size(); }
+
+    // Binds the socket, replacing a stale socket file; false if anything else is at the path
+    bool start()
+    {
+        sockaddr_un address;
+        if(!make_socket_address(socket_path, address))
+            return false;
+        struct stat st;
+        if(lstat(socket_path.c_str(), &st) == 0)
+        {
+            if(!S_ISSOCK(st.st_mode))
+                return false;
+            // A daemon still answering there keeps its socket
+            int live_fd = connect_to_daemon(socket_path);
+            if(live_fd >= 0)
+            {
+                close(live_fd);
+                return false;
+            }
+            if(unlink(socket_path.c_str()) != 0)
+                return false;
+        }
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(listen_fd < 0)
+            return false;
+        if(bind(listen_fd, (sockaddr*)&address, sizeof(address)) != 0)
+        {
+            // Nothing of ours at the path, keep the destructor from removing it
+            close(listen_fd);
+            listen_fd = -1;
+            return false;
+        }
+        return listen(listen_fd, 64) == 0;
+    }
+
+    // Serves connections until a SHUTDOWN request, returns the number of jobs served
+    size_t run()
+    {
+        while(!stopping)
+        {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if(fd < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                break;
+            }
+            // recv() and send() give up on clients that stop sending or reading, so they can't hold workers
+            set_socket_timeout(fd, SO_RCVTIMEO, DAEMON_RECV_TIMEOUT_MS);
+            set_socket_timeout(fd, SO_SNDTIMEO, DAEMON_SEND_TIMEOUT_MS);
+            pool.submit([this, fd] {
+                // One bad job must not take the daemon down; once a reply is under way the client
+                // can't tell an error line from payload, so the connection is only closed
+                bool replied = false;
+                try
+                {
+                    serve_connection(fd, replied);
+                }
+                catch(const std::exception &e)
+                {
+                    if(!replied)
+                        write_line(fd, std::string("ERROR ") + e.what());
+                }
+                close(fd);
+            });
+        }
+        pool.wait();
+        return num_jobs;
+    }
+
+private:
+    static void set_socket_timeout(int fd, int option, int timeout_ms)
+    {
+        timeval timeout;
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_usec = (timeout_ms % 1000) * 1000;
+        setsockopt(fd, SOL_SOCKET, option, &timeout, sizeof(timeout));
+    }
+
+    // replied is set once the OK line of a job starts going out
+    void serve_connection(int fd, bool &replied)
+    {
+        std::string line;
+        if(!read_line(fd, line))
+            return;
+        std::istringstream fields(line);
+        std::string command, source, output_path;
+        fields >> command;
+
+        if(command == "SHUTDOWN")
+        {
+            stopping = true;
+            // Wakes the accept() in run()
+            shutdown(listen_fd, SHUT_RDWR);
+            write_line(fd, "OK 0 0 0");
+            return;
+        }
+        float isovalue = runtime_parameters().isovalue;
+        int num_voxel = runtime_parameters().num_voxel;
+        if(!(fields >> source >> output_path) || (command != "MESH" && command != "POINTS"))
+        {
+            write_line(fd, "ERROR bad request: " + line);
+            return;
+        }
+        float requested_isovalue;
+        int requested_num_voxel;
+        if(fields >> requested_isovalue)
+        {
+            isovalue = requested_isovalue;
+            if(fields >> requested_num_voxel)
+                num_voxel = requested_num_voxel;
+        }
+        if(num_voxel <= 0)
+        {
+            write_line(fd, "ERROR bad request: " + line);
+            return;
+        }
+
+        auto start_job = std::chrono::high_resolution_clock::now();
+        std::shared_ptr<const DensityGrid> grid;
+        std::string error;
+        if(command == "MESH")
+            grid = load_grid(source, num_voxel, error);
+        else
+            grid = receive_grid(fd, source, num_voxel, error);
+        if(!grid)
+        {
+            write_line(fd, "ERROR " + error);
+            return;
+        }
+
+        static thread_local MarchingTetrahedra extractor(serial_extractor_config());
+        static thread_local IndexedMesh mesh;
+        extractor.extract(*grid, isovalue, mesh);
+        postprocess_mesh(mesh, *grid);
+
+        if(output_path != "-" && !write_mesh_file(mesh, *grid, output_path))
+        {
+            write_line(fd, "ERROR failed to write " + output_path);
+            return;
+        }
+        std::chrono::duration<double, std::milli> job_duration = std::chrono::high_resolution_clock::now() - start_job;
+        num_jobs++;
+
+        // Inline vertices are packed before the OK line goes out, so failing here still gets an ERROR
+        static thread_local std::vector<float> xyz;
+        if(output_path == "-")
+        {
+            xyz.resize(3 * mesh.num_vertices());
+            for(size_t v = 0; v < mesh.num_vertices(); v++)
+            {
+                xyz[3 * v] = mesh.x[v];
+                xyz[3 * v + 1] = mesh.y[v];
+                xyz[3 * v + 2] = mesh.z[v];
+            }
+        }
+
+        std::ostringstream reply;
+        reply << "OK " << mesh.num_vertices() << " " << mesh.num_faces() << " " << job_duration.count();
+        replied = true;
+        if(!write_line(fd, reply.str()) || output_path != "-")
+            return;
+        if(write_all(fd, xyz.data(), xyz.size() * sizeof(float)))
+            write_all(fd, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+    }
+
+    std::shared_ptr<const DensityGrid> load_grid(const std::string &path, int num_voxel, std::string &error)
+    {
+        std::shared_ptr<const DensityGrid> grid = grid_cache.find(path, num_voxel);
+        if(grid)
+            return grid;
+
+        std::vector<Vec3f> pointcloud = get_pointcloud_from_file(path);
+        if(pointcloud.empty())
+        {
+            error = "failed to read pointcloud " + path;
+            return nullptr;
+        }
+        grid = std::make_shared<const DensityGrid>(build_grid_for_pointcloud(pointcloud, num_voxel));
+        grid_cache.insert(path, num_voxel, grid);
+        return grid;
+    }
+
+    // Points sent inline; coordinates are truncated to integers like the file readers do
+    std::shared_ptr<const DensityGrid> receive_grid(int fd, const std::string &count, int num_voxel, std::string &error)
+    {
+        char* end;
+        size_t num_points = strtoull(count.c_str(), &end, 10);
+        if(count.empty() || *end != '\0' || count[0] == '-' || num_points == 0 || num_points > DAEMON_MAX_POINTS)
+        {
+            error = "bad number of points: " + count;
+            return nullptr;
+        }
+        std::vector<float> xyz(3 * num_points);
+        if(!read_all(fd, xyz.data(), xyz.size() * sizeof(float)))
+        {
+            error = "no points received";
+            return nullptr;
+        }
+
+        std::vector<Vec3f> pointcloud(num_points);
+        for(size_t p = 0; p < num_points; p++)
+            pointcloud[p] = Vec3f((int)xyz[3 * p], (int)xyz[3 * p + 1], (int)xyz[3 * p + 2]);
+        return std::make_shared<const DensityGrid>(build_grid_for_pointcloud(pointcloud, num_voxel));
+    }
+
+    std::string socket_path;
+    int listen_fd = -1;
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> num_jobs{0};
+    ThreadPool pool;
+    DensityGridMemoryCache grid_cache;
+};
+// ===============================================================
+
+#endif
@@ -0,0 +1,418 @@
+#ifndef MESH_DECIMATE
+#define MESH_DECIMATE
+
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <vector>
+
+#include "indexed_mesh.h"
+#include "vertex_hash.h"
+#include "mesh_optimize.h"
+
+// ===============================================================
+// Quadric error decimation of an IndexedMesh (Garland & Heckbert, "Surface Simplification
+// Using Quadric Error Metrics")
+// - every vertex sums the area weighted plane quadrics of its faces; boundary edges add a
+//   plane perpendicular to their face so open borders keep their shape
+// - edges are collapsed cheapest first from a heap to the position minimising the summed
+//   quadric; entries are dropped lazily once one of their vertices changed
+// - the cost is the quadric error divided by its summed weight, i.e. the weighted mean squared
+//   distance to the planes, so it compares against a squared distance whatever the grid spacing
+// - a collapse is skipped if it would flip a face or make the surface non-manifold
+
+// Symmetric 4x4 matrix of a sum of squared plane distances, upper triangle, and the summed weights
+struct Quadric
+{
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    double weight;
+
+    Quadric() { memset(this, 0, sizeof(*this)); }
+
+    // Plane a x + b y + c z + d = 0 with unit normal
+    void add_plane(double a, double b, double c, double d, double weight)
+    {
+        a2 += weight * a * a; ab += weight * a * b; ac += weight * a * c; ad += weight * a * d;
+        b2 += weight * b * b; bc += weight * b * c; bd += weight * b * d;
+        c2 += weight * c * c; cd += weight * c * d;
+        d2 += weight * d * d;
+        this->weight += weight;
+    }
+
+    void add(const Quadric &q)
+    {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+        b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd;
+        d2 += q.d2;
+        weight += q.weight;
+    }
+
+    double error(double x, double y, double z) const
+    {
+        return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+             + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+             + c2 * z * z + 2 * cd * z + d2;
+    }
+
+    // Weighted mean squared distance to the planes
+    double mean_error(double x, double y, double z) const
+    {
+        return weight > 0 ? error(x, y, z) / weight : 0;
+    }
+
+    // Point of least error, false if the quadric is (nearly) singular
+    bool optimum(double &x, double &y, double &z) const
+    {
+        double det = a2 * (b2 * c2 - bc * bc) - ab * (ab * c2 - bc * ac) + ac * (ab * bc - b2 * ac);
+        double scale = a2 + b2 + c2;
+        if(std::fabs(det) <= 1e-9 * scale * scale * scale)
+            return false;
+
+        // Cramer's rule on A p = -(ad, bd, cd)
+        x = -(ad * (b2 * c2 - bc * bc) - ab * (bd * c2 - bc * cd) + ac * (bd * bc - b2 * cd)) / det;
+        y = -(a2 * (bd * c2 - cd * bc) - ad * (ab * c2 - bc * ac) + ac * (ab * cd - bd * ac)) / det;
+        z = -(a2 * (b2 * cd - bc * bd) - ab * (ab * cd - bd * ac) + ad * (ab * bc - b2 * ac)) / det;
+        return true;
+    }
+};
+
+struct DecimateStats
+{
+    size_t collapses = 0;
+    size_t rejected = 0;
+    // Largest cost of a collapse made, squared distance
+    double max_error = 0;
+};
+
+class MeshDecimator
+{
+public:
+    explicit MeshDecimator(IndexedMesh &mesh) : mesh(mesh) {}
+
+    // Collapse edges until at most target_faces faces are left or the next collapse would cost
+    // more than max_error (squared distance, <= 0 for no bound)
+    void run(size_t target_faces, double max_error, DecimateStats &stats)
+    {
+        stats = DecimateStats();
+        init();
+        for(size_t v = 0; v < num_vertices; v++)
+            push_vertex_edges(v);
+
+        size_t live_faces = mesh.num_faces();
+        while(live_faces > target_faces && !heap.empty())
+        {
+            Candidate top = heap.top();
+            heap.pop();
+            if(removed[top.u] || removed[top.v] || stamp[top.u] != top.stamp_u || stamp[top.v] != top.stamp_v)
+                continue;
+            if(max_error > 0 && top.cost > max_error)
+                break;
+            if(!can_collapse(top.u, top.v, top.x, top.y, top.z))
+            {
+                // Comes back once a neighbour collapse changes u or v
+                stats.rejected++;
+                continue;
+            }
+
+            live_faces -= collapse(top.u, top.v, top.x, top.y, top.z);
+            stats.collapses++;
+            stats.max_error = std::max(stats.max_error, top.cost);
+            push_vertex_edges(top.u);
+        }
+
+        compact();
+    }
+
+private:
+    struct Candidate
+    {
+        double cost;
+        double x, y, z;
+        uint32_t u, v;
+        uint32_t stamp_u, stamp_v;
+
+        bool operator<(const Candidate &rhs) const { return cost > rhs.cost; }
+    };
+
+    void face_normal(uint32_t a, uint32_t b, uint32_t c, double n[3]) const
+    {
+        double e1[3] = {px[b] - px[a], py[b] - py[a], pz[b] - pz[a]};
+        double e2[3] = {px[c] - px[a], py[c] - py[a], pz[c] - pz[a]};
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    void init()
+    {
+        num_vertices = mesh.num_vertices();
+        size_t num_faces = mesh.num_faces();
+        px.assign(mesh.x.begin(), mesh.x.end());
+        py.assign(mesh.y.begin(), mesh.y.end());
+        pz.assign(mesh.z.begin(), mesh.z.end());
+        quadrics.assign(num_vertices, Quadric());
+        vertex_faces.assign(num_vertices, std::vector<uint32_t>());
+        face_alive.assign(num_faces, 1);
+        removed.assign(num_vertices, 0);
+        stamp.assign(num_vertices, 0);
+        mark.assign(num_vertices, 0);
+        tick = 0;
+
+        // Edge (lower, upper vertex) -> number of faces using it
+        EdgeHashMap edgeMap(mesh.indices.size());
+        std::vector<uint32_t> edge_faces;
+        for(size_t f = 0; f < num_faces; f++)
+        {
+            const uint32_t* face = &mesh.indices[3 * f];
+            for(int c = 0; c < 3; c++)
+            {
+                vertex_faces[face[c]].push_back(f);
+
+                bool inserted;
+                int edge = edgeMap.find_or_insert(edge_key(face[c], face[(c + 1) % 3]), inserted);
+                if(inserted)
+                    edge_faces.push_back(0);
+                edge_faces[edge]++;
+            }
+
+            double n[3];
+            face_normal(face[0], face[1], face[2], n);
+            double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if(length == 0)
+                continue;
+            for(int a = 0; a < 3; a++)
+                n[a] /= length;
+            double d = -(n[0] * px[face[0]] + n[1] * py[face[0]] + n[2] * pz[face[0]]);
+            for(int c = 0; c < 3; c++)
+                quadrics[face[c]].add_plane(n[0], n[1], n[2], d, 0.5 * length);
+        }
+
+        // Border edges: plane through the edge, perpendicular to the face
+        for(size_t f = 0; f < num_faces; f++)
+        {
+            const uint32_t* face = &mesh.indices[3 * f];
+            double n[3];
+            face_normal(face[0], face[1], face[2], n);
+            for(int c = 0; c < 3; c++)
+            {
+                uint32_t a = face[c], b = face[(c + 1) % 3];
+                if(edge_faces[edgeMap.find(edge_key(a, b))] != 1)
+                    continue;
+
+                double e[3] = {px[b] - px[a], py[b] - py[a], pz[b] - pz[a]};
+                double p[3] = {e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0]};
+                double length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+                if(length == 0)
+                    continue;
+                for(int k = 0; k < 3; k++)
+                    p[k] /= length;
+                double d = -(p[0] * px[a] + p[1] * py[a] + p[2] * pz[a]);
+                double weight = BORDER_WEIGHT * (e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+                quadrics[a].add_plane(p[0], p[1], p[2], d, weight);
+                quadrics[b].add_plane(p[0], p[1], p[2], d, weight);
+            }
+        }
+    }
+
+    static uint64_t edge_key(uint32_t a, uint32_t b)
+    {
+        return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+    }
+
+    // Cheapest position for collapsing edge (u, v) and its cost
+    Candidate evaluate(uint32_t u, uint32_t v) const
+    {
+        Quadric q = quadrics[u];
+        q.add(quadrics[v]);
+
+        Candidate candidate;
+        candidate.u = u;
+        candidate.v = v;
+        candidate.stamp_u = stamp[u];
+        candidate.stamp_v = stamp[v];
+        if(q.optimum(candidate.x, candidate.y, candidate.z))
+        {
+            candidate.cost = q.mean_error(candidate.x, candidate.y, candidate.z);
+            return candidate;
+        }
+
+        // Flat or straight neighbourhood: best of the endpoints and the midpoint
+        double options[3][3] = {{px[u], py[u], pz[u]}, {px[v], py[v], pz[v]},
+                                {0.5 * (px[u] + px[v]), 0.5 * (py[u] + py[v]), 0.5 * (pz[u] + pz[v])}};
+        candidate.cost = INFINITY;
+        for(auto &option: options)
+        {
+            double cost = q.mean_error(option[0], option[1], option[2]);
+            if(cost < candidate.cost)
+            {
+                candidate.cost = cost;
+                candidate.x = option[0];
+                candidate.y = option[1];
+                candidate.z = option[2];
+            }
+        }
+        return candidate;
+    }
+
+    // Edges from v to each neighbour, once per neighbour
+    void push_vertex_edges(uint32_t v)
+    {
+        tick++;
+        for(uint32_t f: vertex_faces[v])
+        {
+            if(!face_alive[f])
+                continue;
+            for(int c = 0; c < 3; c++)
+            {
+                uint32_t w = mesh.indices[3 * f + c];
+                if(w == v || mark[w] == tick)
+                    continue;
+                mark[w] = tick;
+                heap.push(evaluate(v, w));
+            }
+        }
+    }
+
+    bool can_collapse(uint32_t u, uint32_t v, double x, double y, double z)
+    {
+        // Link condition: u and v share exactly the neighbours of the faces on edge (u, v)
+        tick++;
+        for(uint32_t f: vertex_faces[u])
+            if(face_alive[f])
+                for(int c = 0; c < 3; c++)
+                    mark[mesh.indices[3 * f + c]] = tick;
+        size_t shared_faces = 0;
+        size_t common = 0;
+        uint32_t counted = ++tick;
+        for(uint32_t f: vertex_faces[v])
+        {
+            if(!face_alive[f])
+                continue;
+            const uint32_t* face = &mesh.indices[3 * f];
+            if(face[0] == u || face[1] == u || face[2] == u)
+                shared_faces++;
+            for(int c = 0; c < 3; c++)
+            {
+                uint32_t w = face[c];
+                if(w != u && w != v && mark[w] == counted - 1)
+                {
+                    mark[w] = counted;
+                    common++;
+                }
+            }
+        }
+        if(common != shared_faces)
+            return false;
+
+        // No remaining face may turn over
+        for(uint32_t moved: {u, v})
+            for(uint32_t f: vertex_faces[moved])
+            {
+                if(!face_alive[f])
+                    continue;
+                const uint32_t* face = &mesh.indices[3 * f];
+                bool has_u = face[0] == u || face[1] == u || face[2] == u;
+                bool has_v = face[0] == v || face[1] == v || face[2] == v;
+                if(has_u && has_v)
+                    continue;
+
+                double before[3];
+                face_normal(face[0], face[1], face[2], before);
+                double saved[3] = {px[moved], py[moved], pz[moved]};
+                px[moved] = x;
+                py[moved] = y;
+                pz[moved] = z;
+                double after[3];
+                face_normal(face[0], face[1], face[2], after);
+                px[moved] = saved[0];
+                py[moved] = saved[1];
+                pz[moved] = saved[2];
+
+                if(before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0)
+                    return false;
+            }
+        return true;
+    }
+
+    // Merge v into u at (x, y, z), returns the number of faces removed
+    size_t collapse(uint32_t u, uint32_t v, double x, double y, double z)
+    {
+        px[u] = x;
+        py[u] = y;
+        pz[u] = z;
+        quadrics[u].add(quadrics[v]);
+        removed[v] = 1;
+        stamp[u]++;
+        stamp[v]++;
+
+        size_t removed_faces = 0;
+        for(uint32_t f: vertex_faces[v])
+        {
+            if(!face_alive[f])
+                continue;
+            uint32_t* face = &mesh.indices[3 * f];
+            if(face[0] == u || face[1] == u || face[2] == u)
+            {
+                face_alive[f] = 0;
+                removed_faces++;
+                continue;
+            }
+            for(int c = 0; c < 3; c++)
+                if(face[c] == v)
+                    face[c] = u;
+            vertex_faces[u].push_back(f);
+        }
+        std::vector<uint32_t>().swap(vertex_faces[v]);
+
+        std::vector<uint32_t> &faces = vertex_faces[u];
+        faces.erase(std::remove_if(faces.begin(), faces.end(), [this](uint32_t f) { return !face_alive[f]; }), faces.end());
+        return removed_faces;
+    }
+
+    void compact()
+    {
+        size_t kept = 0;
+        for(size_t f = 0; f < face_alive.size(); f++)
+            if(face_alive[f])
+            {
+                for(int c = 0; c < 3; c++)
+                    mesh.indices[3 * kept + c] = mesh.indices[3 * f + c];
+                kept++;
+            }
+        mesh.indices.resize(3 * kept);
+        for(size_t v = 0; v < num_vertices; v++)
+        {
+            mesh.x[v] = px[v];
+            mesh.y[v] = py[v];
+            mesh.z[v] = pz[v];
+        }
+
+        // Moved vertices no longer lie on their grid edge
+        mesh.edge_ids.clear();
+        reorder_vertices_by_first_use(mesh);
+    }
+
+    static constexpr double BORDER_WEIGHT = 10.0;
+
+    IndexedMesh &mesh;
+    size_t num_vertices = 0;
+    std::vector<double> px, py, pz;
+    std::vector<Quadric> quadrics;
+    std::vector<std::vector<uint32_t>> vertex_faces;
+    std::vector<char> face_alive;
+    std::vector<char> removed;
+    std::vector<uint32_t> stamp;
+    std::vector<uint32_t> mark;
+    uint32_t tick = 0;
+    std::priority_queue<Candidate> heap;
+};
+
+void decimate_mesh(IndexedMesh &mesh, size_t target_faces, double max_error, DecimateStats &stats)
+{
+    MeshDecimator decimator(mesh);
+    decimator.run(target_faces, max_error, stats);
+}
+// ===============================================================
+
+#endif
@@ -0,0 +1,322 @@
+#ifndef MESH_OPTIMIZE
+#define MESH_OPTIMIZE
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "indexed_mesh.h"
+
+// ===============================================================
+// Render order optimisation of an IndexedMesh
+// - faces reordered for post-transform vertex cache hits (Forsyth, "Linear-Speed Vertex Cache
+//   Optimisation"), vertices renumbered by first reference in the new face order
+// - ACMR (vertex shader runs per face) measured on a FIFO cache
+// - faces grouped into meshlets in face order, each with a bounding sphere
+
+// Average cache misses per face when the faces go through a FIFO cache of cache_size vertices
+double compute_acmr(const IndexedMesh &mesh, int cache_size)
+{
+    if(mesh.num_faces() == 0)
+        return 0;
+
+    // A vertex is cached while fewer than cache_size misses happened since it was loaded
+    std::vector<int64_t> loaded_at(mesh.num_vertices(), -1);
+    int64_t misses = 0;
+    for(uint32_t index: mesh.indices)
+        if(loaded_at[index] < 0 || misses - loaded_at[index] >= cache_size)
+            loaded_at[index] = misses++;
+    return (double)misses / mesh.num_faces();
+}
+
+// Renumber vertices in order of first reference by the faces
+void reorder_vertices_by_first_use(IndexedMesh &mesh)
+{
+    std::vector<uint32_t> remap(mesh.num_vertices(), UINT32_MAX);
+    IndexedMesh reordered;
+    reordered.x.reserve(mesh.num_vertices());
+    reordered.y.reserve(mesh.num_vertices());
+    reordered.z.reserve(mesh.num_vertices());
+    for(uint32_t &index: mesh.indices)
+    {
+        if(remap[index] == UINT32_MAX)
+        {
+            remap[index] = reordered.num_vertices();
+            reordered.x.push_back(mesh.x[index]);
+            reordered.y.push_back(mesh.y[index]);
+            reordered.z.push_back(mesh.z[index]);
+            if(!mesh.edge_ids.empty())
+                reordered.edge_ids.push_back(mesh.edge_ids[index]);
+        }
+        index = remap[index];
+    }
+
+    // Vertices no face uses are dropped
+    mesh.x.swap(reordered.x);
+    mesh.y.swap(reordered.y);
+    mesh.z.swap(reordered.z);
+    mesh.edge_ids.swap(reordered.edge_ids);
+}
+
+// Forsyth vertex score: recently used vertices and vertices with few faces left score high
+float forsyth_vertex_score(int cache_position, uint32_t remaining_faces, int cache_size)
+{
+    if(remaining_faces == 0)
+        return -1.0f;
+
+    float score = 0;
+    if(cache_position >= 0)
+    {
+        // The three vertices of the last face get a fixed score, so they are not favoured over
+        // each other
+        if(cache_position < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.0f - (float)(cache_position - 3) / (cache_size - 3), 1.5f);
+    }
+    return score + 2.0f / std::sqrt((float)remaining_faces);
+}
+
+// Greedily emit the face with the best vertex score sum next; scores only change for faces of
+// vertices that moved through the modelled LRU cache, so the whole pass is linear in faces
+void optimize_vertex_cache(IndexedMesh &mesh, int cache_size)
+{
+    size_t num_vertices = mesh.num_vertices();
+    size_t num_faces = mesh.num_faces();
+    if(num_faces == 0)
+        return;
+
+    // Faces of each vertex, the not yet emitted ones kept in front
+    std::vector<uint32_t> face_offset(num_vertices + 1, 0);
+    for(uint32_t index: mesh.indices)
+        face_offset[index + 1]++;
+    for(size_t v = 0; v < num_vertices; v++)
+        face_offset[v + 1] += face_offset[v];
+    std::vector<uint32_t> remaining(num_vertices, 0);
+    std::vector<uint32_t> vertex_faces(mesh.indices.size());
+    for(size_t f = 0; f < num_faces; f++)
+        for(int c = 0; c < 3; c++)
+        {
+            uint32_t v = mesh.indices[3 * f + c];
+            vertex_faces[face_offset[v] + remaining[v]++] = f;
+        }
+
+    std::vector<int> cache_position(num_vertices, -1);
+    std::vector<float> vertex_score(num_vertices);
+    for(size_t v = 0; v < num_vertices; v++)
+        vertex_score[v] = forsyth_vertex_score(-1, remaining[v], cache_size);
+
+    std::vector<float> face_score(num_faces);
+    std::vector<char> emitted(num_faces, 0);
+    for(size_t f = 0; f < num_faces; f++)
+        face_score[f] = vertex_score[mesh.indices[3 * f]] + vertex_score[mesh.indices[3 * f + 1]] +
+                        vertex_score[mesh.indices[3 * f + 2]];
+
+    std::vector<uint32_t> cache, next_cache;
+    cache.reserve(cache_size + 3);
+    next_cache.reserve(cache_size + 3);
+
+    std::vector<uint32_t> optimized;
+    optimized.reserve(mesh.indices.size());
+
+    int64_t best_face = 0;
+    size_t next_unemitted = 0;
+    for(size_t emitted_faces = 0; emitted_faces < num_faces; emitted_faces++)
+    {
+        // Nothing left around the cache: continue with the next face in the old order
+        if(best_face < 0)
+        {
+            while(emitted[next_unemitted])
+                next_unemitted++;
+            best_face = next_unemitted;
+        }
+
+        const uint32_t* face = &mesh.indices[3 * best_face];
+        emitted[best_face] = 1;
+        next_cache.clear();
+        for(int c = 0; c < 3; c++)
+        {
+            uint32_t v = face[c];
+            optimized.push_back(v);
+            next_cache.push_back(v);
+
+            uint32_t* faces = &vertex_faces[face_offset[v]];
+            for(uint32_t i = 0; i < remaining[v]; i++)
+                if(faces[i] == best_face)
+                {
+                    std::swap(faces[i], faces[remaining[v] - 1]);
+                    remaining[v]--;
+                    break;
+                }
+        }
+        for(uint32_t v: cache)
+            if(v != face[0] && v != face[1] && v != face[2])
+                next_cache.push_back(v);
+        cache.swap(next_cache);
+
+        // Rescore cached and just evicted vertices and every face they still have
+        for(size_t p = 0; p < cache.size(); p++)
+        {
+            uint32_t v = cache[p];
+            cache_position[v] = p < (size_t)cache_size ? (int)p : -1;
+            vertex_score[v] = forsyth_vertex_score(cache_position[v], remaining[v], cache_size);
+        }
+        best_face = -1;
+        float best_score = -1;
+        for(uint32_t v: cache)
+        {
+            const uint32_t* faces = &vertex_faces[face_offset[v]];
+            for(uint32_t i = 0; i < remaining[v]; i++)
+            {
+                uint32_t f = faces[i];
+                face_score[f] = vertex_score[mesh.indices[3 * f]] + vertex_score[mesh.indices[3 * f + 1]] +
+                                vertex_score[mesh.indices[3 * f + 2]];
+                if(face_score[f] > best_score)
+                {
+                    best_score = face_score[f];
+                    best_face = f;
+                }
+            }
+        }
+        if(cache.size() > (size_t)cache_size)
+            cache.resize(cache_size);
+    }
+
+    mesh.indices.swap(optimized);
+    reorder_vertices_by_first_use(mesh);
+}
+
+// vertices[vertex_offset ..] are mesh indices of the meshlet's vertices,
+// triangles[3 * triangle_offset ..] index into those (one byte each)
+struct Meshlet
+{
+    uint32_t vertex_offset, vertex_count;
+    uint32_t triangle_offset, triangle_count;
+    float center[3];
+    float radius;
+};
+
+struct MeshletSet
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+};
+
+// Cut the faces, in their current order, into runs of at most max_vertices distinct
+// vertices and max_triangles faces (max_vertices <= 256)
+void build_meshlets(const IndexedMesh &mesh, int max_vertices, int max_triangles, MeshletSet &set)
+{
+    set.meshlets.clear();
+    set.vertices.clear();
+    set.triangles.clear();
+
+    // Local index of each mesh vertex in the open meshlet, valid if local_owner matches
+    std::vector<uint8_t> local_index(mesh.num_vertices());
+    std::vector<uint32_t> local_owner(mesh.num_vertices(), UINT32_MAX);
+
+    auto close_meshlet = [&](Meshlet &meshlet) {
+        float min_p[3] = {INFINITY, INFINITY, INFINITY}, max_p[3] = {-INFINITY, -INFINITY, -INFINITY};
+        for(uint32_t i = 0; i < meshlet.vertex_count; i++)
+        {
+            uint32_t v = set.vertices[meshlet.vertex_offset + i];
+            float p[3] = {mesh.x[v], mesh.y[v], mesh.z[v]};
+            for(int a = 0; a < 3; a++)
+            {
+                min_p[a] = std::min(min_p[a], p[a]);
+                max_p[a] = std::max(max_p[a], p[a]);
+            }
+        }
+        for(int a = 0; a < 3; a++)
+            meshlet.center[a] = 0.5f * (min_p[a] + max_p[a]);
+
+        float radius_sq = 0;
+        for(uint32_t i = 0; i < meshlet.vertex_count; i++)
+        {
+            uint32_t v = set.vertices[meshlet.vertex_offset + i];
+            float dx = mesh.x[v] - meshlet.center[0];
+            float dy = mesh.y[v] - meshlet.center[1];
+            float dz = mesh.z[v] - meshlet.center[2];
+            radius_sq = std::max(radius_sq, dx * dx + dy * dy + dz * dz);
+        }
+        meshlet.radius = std::sqrt(radius_sq);
+        set.meshlets.push_back(meshlet);
+    };
+
+    Meshlet meshlet;
+    memset(&meshlet, 0, sizeof(meshlet));
+    for(size_t f = 0; f < mesh.num_faces(); f++)
+    {
+        const uint32_t* face = &mesh.indices[3 * f];
+        uint32_t id = set.meshlets.size();
+        int new_vertices = 0;
+        for(int c = 0; c < 3; c++)
+            if(local_owner[face[c]] != id && (c < 1 || face[c] != face[0]) && (c < 2 || face[c] != face[1]))
+                new_vertices++;
+
+        if(meshlet.vertex_count + new_vertices > (uint32_t)max_vertices || meshlet.triangle_count == (uint32_t)max_triangles)
+        {
+            close_meshlet(meshlet);
+            id = set.meshlets.size();
+            meshlet.vertex_offset = set.vertices.size();
+            meshlet.vertex_count = 0;
+            meshlet.triangle_offset = set.triangles.size() / 3;
+            meshlet.triangle_count = 0;
+        }
+
+        for(int c = 0; c < 3; c++)
+        {
+            uint32_t v = face[c];
+            if(local_owner[v] != id)
+            {
+                local_owner[v] = id;
+                local_index[v] = meshlet.vertex_count++;
+                set.vertices.push_back(v);
+            }
+            set.triangles.push_back(local_index[v]);
+        }
+        meshlet.triangle_count++;
+    }
+    if(meshlet.triangle_count > 0)
+        close_meshlet(meshlet);
+}
+
+// Sidecar layout: MeshletFileHeader | Meshlet * num_meshlets | uint32 vertices | uint8 triangles
+struct MeshletFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t num_meshlets;
+    uint64_t num_vertices;
+    uint64_t num_triangles;
+};
+
+static const char MESHLET_FILE_MAGIC[8] = {'M', 'T', 'M', 'L', 'E', 'T', '\0', '\0'};
+static const uint32_t MESHLET_FILE_VERSION = 1;
+
+bool write_meshlets(const std::string &path, const MeshletSet &set)
+{
+    MeshletFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESHLET_FILE_MAGIC, sizeof(header.magic));
+    header.version = MESHLET_FILE_VERSION;
+    header.num_meshlets = set.meshlets.size();
+    header.num_vertices = set.vertices.size();
+    header.num_triangles = set.triangles.size() / 3;
+
+    FILE* outputFile = fopen(path.c_str(), "wb");
+    if(outputFile == nullptr)
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, outputFile) == 1 &&
+              fwrite(set.meshlets.data(), sizeof(Meshlet), set.meshlets.size(), outputFile) == set.meshlets.size() &&
+              fwrite(set.vertices.data(), sizeof(uint32_t), set.vertices.size(), outputFile) == set.vertices.size() &&
+              fwrite(set.triangles.data(), 1, set.triangles.size(), outputFile) == set.triangles.size();
+    return (fclose(outputFile) == 0) && ok;
+}
+// ===============================================================
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef MORTON_ORDER
+#define MORTON_ORDER
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "indexed_mesh.h"
+#include "parallel_sort.h"
+
+// ===============================================================
+// Vertex order along a 3D Morton (Z-order) curve, so nearby vertices get nearby indices
+// - positions are quantised to 21 bits over the longest side of the mesh bounding box
+// - (code, vertex) pairs are radix sorted across the pool (see parallel_sort.h), stable, so
+//   vertices with equal codes keep their old order
+
+// Bits of v spread to every third position
+inline uint64_t spread_bits_3d(uint64_t v)
+{
+    v &= 0x1FFFFF;
+    v = (v | v << 32) & 0x001F00000000FFFFULL;
+    v = (v | v << 16) & 0x001F0000FF0000FFULL;
+    v = (v | v << 8) & 0x100F00F00F00F00FULL;
+    v = (v | v << 4) & 0x10C30C30C30C30C3ULL;
+    v = (v | v << 2) & 0x1249249249249249ULL;
+    return v;
+}
+
+inline uint64_t morton_code(uint32_t qx, uint32_t qy, uint32_t qz)
+{
+    return spread_bits_3d(qx) | spread_bits_3d(qy) << 1 | spread_bits_3d(qz) << 2;
+}
+
+// Mean over faces of the largest index difference within the face
+double mean_face_index_distance(const IndexedMesh &mesh)
+{
+    if(mesh.num_faces() == 0)
+        return 0;
+
+    double sum = 0;
+    for(size_t f = 0; f < mesh.num_faces(); f++)
+    {
+        const uint32_t* face = &mesh.indices[3 * f];
+        sum += std::max({face[0], face[1], face[2]}) - std::min({face[0], face[1], face[2]});
+    }
+    return sum / mesh.num_faces();
+}
+
+void sort_vertices_by_morton_code(IndexedMesh &mesh, ThreadPool &pool)
+{
+    size_t num_vertices = mesh.num_vertices();
+    if(num_vertices == 0)
+        return;
+
+    // Bounding box, one partial box per block
+    int num_blocks = pool.size();
+    std::vector<float> block_min(3 * num_blocks, INFINITY), block_max(3 * num_blocks, -INFINITY);
+    const std::vector<float>* xyz[3] = {&mesh.x, &mesh.y, &mesh.z};
+    parallel_blocks(pool, num_vertices, [&](int b, size_t begin, size_t end) {
+        for(int a = 0; a < 3; a++)
+            for(size_t v = begin; v < end; v++)
+            {
+                block_min[3 * b + a] = std::min(block_min[3 * b + a], (*xyz[a])[v]);
+                block_max[3 * b + a] = std::max(block_max[3 * b + a], (*xyz[a])[v]);
+            }
+    });
+    // Same scale on every axis, so the curve follows distances
+    float min_p[3], extent = 0;
+    for(int a = 0; a < 3; a++)
+    {
+        float lo = INFINITY, hi = -INFINITY;
+        for(int b = 0; b < num_blocks; b++)
+        {
+            lo = std::min(lo, block_min[3 * b + a]);
+            hi = std::max(hi, block_max[3 * b + a]);
+        }
+        min_p[a] = lo;
+        extent = std::max(extent, hi - lo);
+    }
+    float scale = extent > 0 ? 0x1FFFFF / extent : 0;
+
+    std::vector<KeyRef> pairs(num_vertices);
+    parallel_blocks(pool, num_vertices, [&](int /*b*/, size_t begin, size_t end) {
+        for(size_t v = begin; v < end; v++)
+        {
+            uint32_t q[3];
+            for(int a = 0; a < 3; a++)
+                q[a] = (uint32_t)std::min(((*xyz[a])[v] - min_p[a]) * scale, (float)0x1FFFFF);
+            pairs[v].key = morton_code(q[0], q[1], q[2]);
+            pairs[v].ref = (uint32_t)v;
+        }
+    });
+    parallel_radix_sort(pairs, morton_code(0x1FFFFF, 0x1FFFFF, 0x1FFFFF), pool);
+
+    // pairs[n].ref is the old index of new vertex n
+    std::vector<uint32_t> new_index(num_vertices);
+    IndexedMesh sorted;
+    sorted.x.resize(num_vertices);
+    sorted.y.resize(num_vertices);
+    sorted.z.resize(num_vertices);
+    if(!mesh.edge_ids.empty())
+        sorted.edge_ids.resize(num_vertices);
+    parallel_blocks(pool, num_vertices, [&](int /*b*/, size_t begin, size_t end) {
+        for(size_t n = begin; n < end; n++)
+        {
+            uint32_t v = pairs[n].ref;
+            new_index[v] = n;
+            sorted.x[n] = mesh.x[v];
+            sorted.y[n] = mesh.y[v];
+            sorted.z[n] = mesh.z[v];
+            if(!mesh.edge_ids.empty())
+                sorted.edge_ids[n] = mesh.edge_ids[v];
+        }
+    });
+    std::vector<KeyRef>().swap(pairs);
+
+    parallel_blocks(pool, mesh.indices.size(), [&](int /*b*/, size_t begin, size_t end) {
+        for(size_t r = begin; r < end; r++)
+            mesh.indices[r] = new_index[mesh.indices[r]];
+    });
+    mesh.x.swap(sorted.x);
+    mesh.y.swap(sorted.y);
+    mesh.z.swap(sorted.z);
+    mesh.edge_ids.swap(sorted.edge_ids);
+}
+// ===============================================================
+
+#endif
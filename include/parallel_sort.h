@@ -0,0 +1,68 @@
+#ifndef PARALLEL_SORT
+#define PARALLEL_SORT
+
+#include <cstdint>
+#include <vector>
+
+#include "thread_pool.h"
+
+// ===============================================================
+// Block-parallel loops and radix sort on a ThreadPool (used by morton_order.h)
+// (key, reference) pairs are LSD radix sorted 8 bits per pass, every worker histograms and
+// scatters its own block; stable, so equal keys stay in reference order
+struct KeyRef
+{
+    uint64_t key;
+    uint32_t ref;
+};
+
+// Split [0, size) into pool.size() blocks and run task(block, begin, end) on each
+template <typename Task>
+void parallel_blocks(ThreadPool &pool, size_t size, Task task)
+{
+    int num_blocks = pool.size();
+    for(int b = 0; b < num_blocks; b++)
+    {
+        size_t begin = size * b / num_blocks;
+        size_t end = size * (b + 1) / num_blocks;
+        pool.submit([&task, b, begin, end] { task(b, begin, end); });
+    }
+    pool.wait();
+}
+
+void parallel_radix_sort(std::vector<KeyRef> &pairs, uint64_t max_key, ThreadPool &pool)
+{
+    int num_blocks = pool.size();
+    std::vector<KeyRef> scratch(pairs.size());
+    std::vector<size_t> offsets((size_t)num_blocks * 256);
+
+    for(int shift = 0; shift < 64 && (max_key >> shift) != 0; shift += 8)
+    {
+        std::fill(offsets.begin(), offsets.end(), 0);
+        parallel_blocks(pool, pairs.size(), [&](int b, size_t begin, size_t end) {
+            size_t* histogram = &offsets[(size_t)b * 256];
+            for(size_t p = begin; p < end; p++)
+                histogram[(pairs[p].key >> shift) & 0xff]++;
+        });
+
+        // Digit major, block minor: keeps the sort stable across blocks
+        size_t running = 0;
+        for(int digit = 0; digit < 256; digit++)
+            for(int b = 0; b < num_blocks; b++)
+            {
+                size_t count = offsets[(size_t)b * 256 + digit];
+                offsets[(size_t)b * 256 + digit] = running;
+                running += count;
+            }
+
+        parallel_blocks(pool, pairs.size(), [&](int b, size_t begin, size_t end) {
+            size_t* offset = &offsets[(size_t)b * 256];
+            for(size_t p = begin; p < end; p++)
+                scratch[offset[(pairs[p].key >> shift) & 0xff]++] = pairs[p];
+        });
+        pairs.swap(scratch);
+    }
+}
+// ===============================================================
+
+#endif
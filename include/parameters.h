@@ -13,4 +13,93 @@
 // Set ISOVALUE
 #define ISOVALUE 0.5
 
+// Reuse density grid saved next to the input file (<input>.grid) on repeat runs?
+#define USE_GRID_CACHE 1
+
+// Write one PLY per TILE_SIZE^3 voxel tile plus a manifest (TILED_OUTPUT = 1) instead of a single PLY?
+#define TILED_OUTPUT 0
+#define TILE_SIZE 64
+
+// Overlap read / parse / grid / march / write stages (PIPELINE_MODE = 1)?
+// march and write work on chunks of PIPELINE_CHUNK_LAYERS z layers, stages are linked by queues of PIPELINE_QUEUE_SIZE
+#define PIPELINE_MODE 0
+#define PIPELINE_CHUNK_LAYERS 8
+#define PIPELINE_QUEUE_SIZE 4
+#define PIPELINE_BLOCK_SIZE (4 << 20)
+
+// Decompressed block size and number of blocks in flight for .gz inputs
+#define GZIP_BLOCK_SIZE (4 << 20)
+#define GZIP_QUEUE_SIZE 4
+
+// Only mesh points inside [ROI_MIN, ROI_MAX] (USE_ROI = 1)?
+// reads only overlapping tiles when <input>.idx was built by build_index, grid cache is not used
+#define USE_ROI 0
+#define ROI_MIN_X 0
+#define ROI_MIN_Y 0
+#define ROI_MIN_Z 0
+#define ROI_MAX_X 100
+#define ROI_MAX_Y 100
+#define ROI_MAX_Z 100
+#define INDEX_TILE_SIZE 32
+
+// Write output PLY in the background (io_uring, or pwrite threads as fallback) with ASYNC_WRITE_BUFFERS buffers in flight?
+#define ASYNC_WRITE 0
+#define ASYNC_WRITE_BUFFERS 4
+#define ASYNC_WRITE_BUFFER_SIZE ((size_t)8 << 20)
+
+// Hand the mesh to a local process through POSIX shared memory SHM_NAME instead of writing PLY (SHM_OUTPUT = 1)?
+#define SHM_OUTPUT 0
+#define SHM_NAME "/marching_tetrahedrons_mesh"
+
+// Output paths ending in .mtz get the compressed mesh format, positions are quantised to
+// grid spacing / 2^MESH_CODEC_FRACTION_BITS
+#define MESH_CODEC_FRACTION_BITS 8
+
+// Threads marching the density grid, welding vertices through a shared lock-free table (0 = every core);
+// also the number of pipelined march workers
+#define MARCH_THREADS 0
+
+// Snap edge crossings within SNAP_THRESHOLD of the edge length from a grid corner onto the corner and drop
+// the triangles that collapse or repeat (0 = off); with the binary density grids every crossing lies at
+// exactly 1/4 or 3/4, so 0.25 snaps all of them (voxel surface mesh)
+#define SNAP_THRESHOLD 0
+
+// Weld vertices closer than WELD_TOLERANCE * smallest grid spacing and drop collapsed, zero area
+// and repeated faces after marching (CLEAN_MESH = 1)?
+#define CLEAN_MESH 0
+#define WELD_TOLERANCE 1e-3
+
+// Quadric error decimation to DECIMATE_TARGET_RATIO of the faces (DECIMATE = 1)?
+// stops early once a collapse would move the surface more than DECIMATE_MAX_ERROR grid spacings (0 = no bound)
+#define DECIMATE 0
+#define DECIMATE_TARGET_RATIO 0.25
+#define DECIMATE_MAX_ERROR 0.1
+
+// Reorder faces for the post-transform vertex cache of GPUs (OPTIMIZE_VERTEX_CACHE = 1)?
+// vertices are renumbered by first use, ACMR is measured on a FIFO cache of VERTEX_CACHE_SIZE vertices
+#define OPTIMIZE_VERTEX_CACHE 0
+#define VERTEX_CACHE_SIZE 32
+
+// Renumber output vertices along a 3D Morton curve of their positions (MORTON_VERTEX_ORDER = 1)?
+// runs after the vertex cache optimisation, which keeps its face order
+#define MORTON_VERTEX_ORDER 0
+
+// Group faces into meshlets with bounding spheres, written to <output>.meshlets (BUILD_MESHLETS = 1)?
+#define BUILD_MESHLETS 0
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// Return output from a content addressed cache when the same input and parameters were meshed before?
+// least recently used entries are dropped above RESULT_CACHE_MAX_BYTES
+#define USE_RESULT_CACHE 1
+#define RESULT_CACHE_DIR "./.marching_cache"
+#define RESULT_CACHE_MAX_BYTES ((uint64_t)1 << 30)
+
+// Density grids of input files the daemon (--serve) keeps in memory between jobs
+#define DAEMON_GRID_CACHE_ENTRIES 16
+// Idle limit on a daemon connection: a client sending nothing for this long is dropped
+#define DAEMON_RECV_TIMEOUT_MS 5000
+// Same for a client that stops reading its reply
+#define DAEMON_SEND_TIMEOUT_MS 5000
+
 #endif
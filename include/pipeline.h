@@ -0,0 +1,378 @@
+#ifndef PIPELINE
+#define PIPELINE
+
+#include <cstdio>
+#include <atomic>
+#include <unistd.h>
+
+#include "include.h"
+#include "parameters.h"
+#include "utility.h"
+#include "marching_tetrahedrons.h"
+#include "mesh_cleanup.h"
+#include "save_ply.h"
+#include "grid_cache.h"
+#include "pointcloud_io.h"
+#include "thread_pool.h"
+#include "spatial_index.h"
+
+// ===============================================================
+// Pipelined execution: read -> parse -> grid -> march -> write
+// Stages run on their own threads and hand work over through bounded queues.
+// The grid bounds depend on every point, so gridding starts once parsing is done;
+// from there the grid is filled, marched and written in z-ordered chunks.
+// The PLY header counts are padded (see ply_header()), otherwise the output matches write_to_ply().
+
+// Busy time of each stage (waiting on queues is excluded)
+struct PipelineTimes
+{
+    double read_ms = 0;
+    double parse_ms = 0;
+    double voxel_size_ms = 0;
+    double grid_ms = 0;
+    std::atomic<double> march_ms{0};
+    double write_ms = 0;
+    double total_ms = 0;
+    // Output file completely written
+    bool written = false;
+};
+
+double elapsed_ms(std::chrono::high_resolution_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+    return duration.count();
+}
+
+// Welded within the chunk, edge IDs kept to weld across chunks
+struct MarchedChunk
+{
+    int chunk;
+    IndexedMesh mesh;
+};
+
+// Read stage: whole-line text blocks of a TXT pointcloud
+void read_text_blocks(const std::string &path, BoundedQueue<std::string> &blocks, PipelineTimes &times)
+{
+    const size_t block_size = PIPELINE_BLOCK_SIZE;
+    FILE* inputFile = fopen(path.c_str(), "rb");
+    std::string carry;
+    while(inputFile != nullptr)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::string block = carry;
+        size_t offset = block.size();
+        block.resize(offset + block_size);
+        size_t num_read = fread(&block[offset], 1, block_size, inputFile);
+        block.resize(offset + num_read);
+
+        // Keep the trailing partial line for the next block
+        carry.clear();
+        if(num_read == block_size)
+        {
+            size_t last_newline = block.find_last_of('\n');
+            if(last_newline != std::string::npos)
+            {
+                carry = block.substr(last_newline + 1);
+                block.resize(last_newline + 1);
+            }
+        }
+        times.read_ms += elapsed_ms(start);
+
+        if(!block.empty())
+            blocks.push(std::move(block));
+        if(num_read < block_size)
+            break;
+    }
+
+    if(inputFile != nullptr)
+        fclose(inputFile);
+    blocks.close();
+}
+
+// Parse stage: values carry across blocks, see parse_text_block()
+void parse_text_blocks(BoundedQueue<std::string> &blocks, BoundedQueue<std::vector<Vec3f>> &batches, PipelineTimes &times)
+{
+    TextParseState state;
+
+    std::string block;
+    while(blocks.pop(block))
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::vector<Vec3f> batch;
+        batch.reserve(block.size() / 16);
+        parse_text_block(block, state, batch);
+        times.parse_ms += elapsed_ms(start);
+
+        if(!batch.empty())
+            batches.push(std::move(batch));
+    }
+
+    batches.close();
+}
+
+// Write stage: weld chunks in z order and stream them to disk while later chunks are still marched
+// - the header goes first with padded counts, vertices straight after it; PLY lists every vertex
+//   before the faces, so faces go to a temporary file next to the output meanwhile
+// - after the last chunk the faces are appended and the counts patched in place
+size_t write_chunks_to_ply(BoundedQueue<MarchedChunk> &chunks, int num_chunks, const std::string &path, PipelineTimes &times)
+{
+    EdgeHashMap vertexMap;
+    // Faces snapped onto the same vertices, possibly from different chunks, are written once
+    FaceHashSet faceSet;
+    size_t num_faces = 0;
+
+    // Streams that failed to open are still fed, so the queue keeps draining
+    std::string face_path = path + "." + std::to_string(getpid()) + ".faces.tmp";
+    std::ofstream outputFile(path, std::ios::binary);
+    std::ofstream faceFile(face_path, std::ios::binary);
+    outputFile << ply_header(0, 0, PLY_COUNT_WIDTH);
+
+    std::vector<IndexedMesh> waiting(num_chunks);
+    std::vector<bool> arrived(num_chunks, false);
+    int next_chunk = 0;
+    std::vector<int> chunk_to_global;
+
+    MarchedChunk chunk;
+    while(chunks.pop(chunk))
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        waiting[chunk.chunk] = std::move(chunk.mesh);
+        arrived[chunk.chunk] = true;
+        for(; next_chunk < num_chunks && arrived[next_chunk]; next_chunk++)
+        {
+            // Chunk vertices are in first use order, so global numbering stays first use order
+            IndexedMesh &mesh = waiting[next_chunk];
+            chunk_to_global.resize(mesh.num_vertices());
+            for(size_t v = 0; v < mesh.num_vertices(); v++)
+            {
+                bool inserted;
+                chunk_to_global[v] = vertexMap.find_or_insert(mesh.edge_ids[v], inserted);
+                if(inserted)
+                    outputFile << mesh.x[v] << " " << mesh.y[v] << " " << mesh.z[v] << "\n";
+            }
+            for(size_t f = 0; f < mesh.num_faces(); f++)
+            {
+                const uint32_t* face = &mesh.indices[3 * f];
+                if(SNAP_THRESHOLD > 0 && !faceSet.insert(chunk_to_global[face[0]], chunk_to_global[face[1]], chunk_to_global[face[2]]))
+                    continue;
+                faceFile << 3 << " ";
+                for(int c = 0; c < 3; c++)
+                    faceFile << chunk_to_global[face[c]] << " ";
+                faceFile << "\n";
+                num_faces++;
+            }
+            mesh = IndexedMesh();
+        }
+
+        times.write_ms += elapsed_ms(start);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    faceFile.close();
+    bool faces_ok = !faceFile.fail();
+    if(faces_ok && num_faces > 0)
+    {
+        std::ifstream faceInput(face_path, std::ios::binary);
+        outputFile << faceInput.rdbuf();
+    }
+    std::remove(face_path.c_str());
+    outputFile.seekp(0);
+    outputFile << ply_header(vertexMap.size(), num_faces, PLY_COUNT_WIDTH);
+    outputFile.close();
+    times.written = faces_ok && !outputFile.fail();
+
+    times.write_ms += elapsed_ms(start);
+    return num_faces;
+}
+
+// Returns number of triangles written to save_path
+size_t run_pipeline(const std::string &input_path, const std::string &save_path, PipelineTimes &times)
+{
+    auto start_pipeline = std::chrono::high_resolution_clock::now();
+
+    // Grid from cache skips the read/parse/grid stages entirely
+    DensityGrid grid;
+    bool grid_cache_hit = false;
+    if(USE_GRID_CACHE && !USE_ROI)
+        grid_cache_hit = load_grid_cache(grid_cache_path(input_path), input_path, grid);
+
+    // Read + Parse stages
+    BoundedQueue<std::string> blocks(PIPELINE_QUEUE_SIZE);
+    BoundedQueue<std::vector<Vec3f>> batches(PIPELINE_QUEUE_SIZE);
+    std::vector<std::thread> stages;
+    bool is_gzip = is_gzip_file(input_path);
+    bool input_complete = true;
+    bool is_text = has_extension(input_path, ".txt") || (is_gzip && has_extension(input_path, ".txt.gz"));
+    if(!grid_cache_hit && (!is_text || USE_ROI))
+    {
+        // Binary / PLY / region of interest inputs have their own readers and come in as a single batch
+        stages.emplace_back([&] {
+            auto start = std::chrono::high_resolution_clock::now();
+            std::vector<Vec3f> pointcloud = USE_ROI ? get_pointcloud_in_roi(input_path) : get_pointcloud_from_file(input_path);
+            times.read_ms += elapsed_ms(start);
+            batches.push(std::move(pointcloud));
+            batches.close();
+        });
+    }
+    else if(!grid_cache_hit)
+    {
+        if(is_gzip)
+            stages.emplace_back([&] { input_complete = inflate_blocks(input_path, true, blocks, times.read_ms); });
+        else
+            stages.emplace_back([&] { read_text_blocks(input_path, blocks, times); });
+        stages.emplace_back([&] { parse_text_blocks(blocks, batches, times); });
+    }
+    else
+        batches.close();
+
+    // Bounds are tracked while batches arrive
+    std::vector<Vec3f> pointcloud;
+    float min_x = 0, min_y = 0, min_z = 0, max_x = 0, max_y = 0, max_z = 0;
+    std::vector<Vec3f> batch;
+    while(batches.pop(batch))
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        if(batch.empty())
+            continue;
+        float batch_min_x, batch_min_y, batch_min_z, batch_max_x, batch_max_y, batch_max_z;
+        find_min_pixel(batch, batch_min_x, batch_min_y, batch_min_z);
+        find_max_pixel(batch, batch_max_x, batch_max_y, batch_max_z);
+        if(pointcloud.empty())
+        {
+            min_x = batch_min_x; min_y = batch_min_y; min_z = batch_min_z;
+            max_x = batch_max_x; max_y = batch_max_y; max_z = batch_max_z;
+        }
+        else
+        {
+            min_x = std::min(min_x, batch_min_x); min_y = std::min(min_y, batch_min_y); min_z = std::min(min_z, batch_min_z);
+            max_x = std::max(max_x, batch_max_x); max_y = std::max(max_y, batch_max_y); max_z = std::max(max_z, batch_max_z);
+        }
+        pointcloud.insert(pointcloud.end(), batch.begin(), batch.end());
+
+        times.voxel_size_ms += elapsed_ms(start);
+    }
+    for(auto &stage: stages)
+        stage.join();
+    stages.clear();
+
+    if(!grid_cache_hit && (pointcloud.empty() || !input_complete))
+        return 0;
+
+    // Grid stage: layout first, then densities layer by layer
+    std::vector<std::vector<int>> layer_points;
+    if(!grid_cache_hit)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        float voxel_dx, voxel_dy, voxel_dz;
+        cal_voxel_size(min_x, min_y, min_z, max_x, max_y, max_z, voxel_dx, voxel_dy, voxel_dz, runtime_parameters().num_voxel);
+        if(voxel_dx == 0)
+            voxel_dx = 1;
+        if(voxel_dy == 0)
+            voxel_dy = 1;
+        if(voxel_dz == 0)
+            voxel_dz = 1;
+        times.voxel_size_ms += elapsed_ms(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<Vec3f> no_points;
+        grid = build_density_grid(no_points, min_x, min_y, min_z, max_x, max_y, max_z, voxel_dx, voxel_dy, voxel_dz);
+
+        // Bucket points by z layer so each chunk only touches its own points
+        layer_points.resize(grid.nz);
+        for(size_t t = 0; t < pointcloud.size(); t++)
+        {
+            int k = (int)((pointcloud[t].z - grid.origin_z) / grid.dz);
+            if(grid.origin_z + k * grid.dz == pointcloud[t].z)
+                layer_points[k].push_back(t);
+        }
+        times.grid_ms += elapsed_ms(start);
+    }
+
+    // March stage: workers pick up chunks of PIPELINE_CHUNK_LAYERS voxel layers
+    int num_layers = grid.nz - 1;
+    int num_chunks = (num_layers + PIPELINE_CHUNK_LAYERS - 1) / PIPELINE_CHUNK_LAYERS;
+    BoundedQueue<int> ready_chunks(num_chunks + 1);
+    BoundedQueue<MarchedChunk> marched_chunks(PIPELINE_QUEUE_SIZE);
+
+    int num_workers = resolve_num_threads(MARCH_THREADS);
+    std::atomic<int> active_workers(num_workers);
+    for(int w = 0; w < num_workers; w++)
+        stages.emplace_back([&] {
+            int chunk_index;
+            while(ready_chunks.pop(chunk_index))
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+
+                MarchedChunk chunk;
+                chunk.chunk = chunk_index;
+                int k_begin = chunk_index * PIPELINE_CHUNK_LAYERS;
+                int k_end = std::min(k_begin + PIPELINE_CHUNK_LAYERS, num_layers);
+                MeshBuilder triangles(chunk.mesh, true);
+                march_cells(grid, triangles, 0, grid.nx - 1, 0, grid.ny - 1, k_begin, k_end);
+
+                double ms = elapsed_ms(start);
+                double expected = times.march_ms.load();
+                while(!times.march_ms.compare_exchange_weak(expected, expected + ms));
+
+                marched_chunks.push(std::move(chunk));
+            }
+            if(--active_workers == 0)
+                marched_chunks.close();
+        });
+
+    // Write stage
+    size_t num_triangles = 0;
+    stages.emplace_back([&] { num_triangles = write_chunks_to_ply(marched_chunks, num_chunks, save_path, times); });
+
+    // Fill node layers chunk by chunk; a chunk is released once the first layer of the next one exists
+    for(int c = 0; c < num_chunks; c++)
+    {
+        if(!grid_cache_hit)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            int k_begin = c * PIPELINE_CHUNK_LAYERS;
+            int k_end = (c == num_chunks - 1) ? grid.nz : std::min(k_begin + PIPELINE_CHUNK_LAYERS, grid.nz);
+            for(int k = k_begin; k < k_end; k++)
+                for(int t: layer_points[k])
+                {
+                    int i = (int)((pointcloud[t].x - grid.origin_x) / grid.dx);
+                    int j = (int)((pointcloud[t].y - grid.origin_y) / grid.dy);
+                    if(grid.origin_x + i * grid.dx != pointcloud[t].x || grid.origin_y + j * grid.dy != pointcloud[t].y)
+                        continue;
+                    grid.density[((size_t)k * grid.ny + j) * grid.nx + i] = -1;
+                }
+
+            times.grid_ms += elapsed_ms(start);
+        }
+
+        if(c > 0)
+            ready_chunks.push(c - 1);
+    }
+    if(num_chunks > 0)
+        ready_chunks.push(num_chunks - 1);
+    ready_chunks.close();
+
+    if(!grid_cache_hit && USE_GRID_CACHE && !USE_ROI)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        if(!save_grid_cache(grid_cache_path(input_path), input_path, grid))
+            std::cout << "Failed to save grid cache: " << grid_cache_path(input_path) << std::endl;
+        times.grid_ms += elapsed_ms(start);
+    }
+
+    for(auto &stage: stages)
+        stage.join();
+
+    times.total_ms = elapsed_ms(start_pipeline);
+    return num_triangles;
+}
+// ===============================================================
+
+#endif
@@ -0,0 +1,297 @@
+#ifndef POINTCLOUD_IO
+#define POINTCLOUD_IO
+
+#include <cstring>
+#include <sstream>
+
+#include "include.h"
+#include "utility.h"
+#include "mapped_file.h"
+#include "gzip_stream.h"
+
+// ===============================================================
+// Binary pointcloud readers (files are mmapped, no text parsing)
+// Coordinates are truncated to int like get_pointcloud_from_txt()
+
+bool has_extension(const std::string &path, const std::string &ext)
+{
+    return path.size() >= ext.size() &&
+           path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+// Position of the '.' starting the file extension, path.size() if there is none
+size_t extension_start(const std::string &path)
+{
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return path.size();
+    return dot;
+}
+
+// Raw packed float32 triples: x0 y0 z0 x1 y1 z1 ...
+std::vector<Vec3f> get_pointcloud_from_raw(std::string raw_path)
+{
+    std::vector<Vec3f> pointcloud;
+
+    MappedFile file;
+    if(!map_file(raw_path.c_str(), file))
+        return pointcloud;
+
+    size_t num_points = file.size / (3 * sizeof(float));
+    const float* xyz = (const float*)file.data;
+    pointcloud.reserve(num_points);
+    for(size_t i = 0; i < num_points; i++)
+        pointcloud.push_back(Vec3f((int)xyz[3 * i], (int)xyz[3 * i + 1], (int)xyz[3 * i + 2]));
+
+    unmap_file(file);
+    return pointcloud;
+}
+
+// LZF decompression used by PCD "binary_compressed" (same format as liblzf)
+bool lzf_decompress(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size)
+{
+    const uint8_t* ip = in;
+    const uint8_t* in_end = in + in_size;
+    uint8_t* op = out;
+    uint8_t* out_end = out + out_size;
+
+    while(ip < in_end)
+    {
+        unsigned int ctrl = *ip++;
+
+        // Literal run of (ctrl + 1) bytes
+        if(ctrl < (1 << 5))
+        {
+            ctrl++;
+            if(op + ctrl > out_end || ip + ctrl > in_end)
+                return false;
+            memcpy(op, ip, ctrl);
+            op += ctrl;
+            ip += ctrl;
+            continue;
+        }
+
+        // Back reference
+        unsigned int len = ctrl >> 5;
+        if(len == 7)
+        {
+            if(ip >= in_end)
+                return false;
+            len += *ip++;
+        }
+        if(ip >= in_end)
+            return false;
+
+        const uint8_t* ref = op - ((ctrl & 0x1f) << 8) - 1 - *ip++;
+        len += 2;
+        if(ref < out || op + len > out_end)
+            return false;
+
+        // Regions may overlap, copy byte by byte
+        for(unsigned int i = 0; i < len; i++)
+            *op++ = *ref++;
+    }
+
+    return op == out_end;
+}
+
+struct PCDField
+{
+    std::string name;
+    int size;
+    char type;
+    int count;
+    size_t offset;
+};
+
+std::vector<Vec3f> get_pointcloud_from_pcd(std::string pcd_path)
+{
+    std::vector<Vec3f> pointcloud;
+
+    MappedFile file;
+    if(!map_file(pcd_path.c_str(), file))
+        return pointcloud;
+
+    // Parse ASCII header up to (and including) the DATA line
+    std::vector<PCDField> fields;
+    size_t num_points = 0;
+    std::string data_type;
+    size_t pos = 0;
+    while(pos < file.size && data_type.empty())
+    {
+        const char* line_end = (const char*)memchr(file.data + pos, '\n', file.size - pos);
+        size_t len = line_end ? line_end - (file.data + pos) : file.size - pos;
+        std::istringstream line(std::string(file.data + pos, len));
+        pos += len + 1;
+
+        std::string key;
+        line >> key;
+        if(key == "FIELDS")
+        {
+            std::string name;
+            while(line >> name)
+                fields.push_back(PCDField{name, 4, 'F', 1, 0});
+        }
+        else if(key == "SIZE")
+            for(size_t f = 0; f < fields.size(); f++)
+                line >> fields[f].size;
+        else if(key == "TYPE")
+            for(size_t f = 0; f < fields.size(); f++)
+                line >> fields[f].type;
+        else if(key == "COUNT")
+            for(size_t f = 0; f < fields.size(); f++)
+                line >> fields[f].count;
+        else if(key == "POINTS")
+            line >> num_points;
+        else if(key == "DATA")
+            line >> data_type;
+    }
+
+    // Locate x, y, z and the point record layout
+    size_t point_size = 0;
+    int xyz_field[3] = {-1, -1, -1};
+    for(size_t f = 0; f < fields.size(); f++)
+    {
+        fields[f].offset = point_size;
+        point_size += (size_t)fields[f].size * fields[f].count;
+        for(int a = 0; a < 3; a++)
+            if(fields[f].name == std::string(1, (char)('x' + a)) && fields[f].type == 'F' &&
+               (fields[f].size == 4 || fields[f].size == 8))
+                xyz_field[a] = f;
+    }
+    if(xyz_field[0] < 0 || xyz_field[1] < 0 || xyz_field[2] < 0)
+    {
+        unmap_file(file);
+        return pointcloud;
+    }
+
+    pointcloud.reserve(num_points);
+    if(data_type == "ascii")
+    {
+        std::istringstream body(std::string(file.data + pos, file.size - std::min(pos, file.size)));
+        for(size_t i = 0; i < num_points; i++)
+        {
+            double xyz[3] = {0, 0, 0};
+            for(size_t f = 0; f < fields.size(); f++)
+                for(int c = 0; c < fields[f].count; c++)
+                {
+                    double value;
+                    body >> value;
+                    for(int a = 0; a < 3; a++)
+                        if(xyz_field[a] == (int)f && c == 0)
+                            xyz[a] = value;
+                }
+            if(!body)
+                break;
+            pointcloud.push_back(Vec3f((int)xyz[0], (int)xyz[1], (int)xyz[2]));
+        }
+    }
+    else if(data_type == "binary")
+    {
+        // Point-interleaved records, read straight from the mapping
+        if(pos + num_points * point_size <= file.size)
+        {
+            const char* records = file.data + pos;
+            for(size_t i = 0; i < num_points; i++)
+            {
+                float xyz[3];
+                for(int a = 0; a < 3; a++)
+                {
+                    const PCDField &field = fields[xyz_field[a]];
+                    const char* value = records + i * point_size + field.offset;
+                    if(field.size == 4)
+                        memcpy(&xyz[a], value, sizeof(float));
+                    else
+                    {
+                        double tmp;
+                        memcpy(&tmp, value, sizeof(double));
+                        xyz[a] = tmp;
+                    }
+                }
+                pointcloud.push_back(Vec3f((int)xyz[0], (int)xyz[1], (int)xyz[2]));
+            }
+        }
+    }
+    else if(data_type == "binary_compressed")
+    {
+        // uint32 compressed size | uint32 uncompressed size | LZF data
+        // decompressed data is field-major: all x, then all y, ...
+        uint32_t sizes[2];
+        if(pos + sizeof(sizes) <= file.size)
+        {
+            memcpy(sizes, file.data + pos, sizeof(sizes));
+            // Sizes are checked before allocating; an LZF back reference expands 3 bytes to at most 264
+            bool sizes_ok = pos + sizeof(sizes) + sizes[0] <= file.size &&
+                            sizes[1] == num_points * point_size && sizes[1] <= (uint64_t)sizes[0] * 88;
+            std::vector<uint8_t> buffer(sizes_ok ? sizes[1] : 0);
+            if(sizes_ok &&
+               lzf_decompress((const uint8_t*)file.data + pos + sizeof(sizes), sizes[0], buffer.data(), buffer.size()))
+            {
+                for(size_t i = 0; i < num_points; i++)
+                {
+                    float xyz[3];
+                    for(int a = 0; a < 3; a++)
+                    {
+                        const PCDField &field = fields[xyz_field[a]];
+                        const uint8_t* value = buffer.data() + field.offset * num_points + i * field.size * field.count;
+                        if(field.size == 4)
+                            memcpy(&xyz[a], value, sizeof(float));
+                        else
+                        {
+                            double tmp;
+                            memcpy(&tmp, value, sizeof(double));
+                            xyz[a] = tmp;
+                        }
+                    }
+                    pointcloud.push_back(Vec3f((int)xyz[0], (int)xyz[1], (int)xyz[2]));
+                }
+            }
+        }
+    }
+
+    unmap_file(file);
+    return pointcloud;
+}
+// ===============================================================
+
+// PLY vertices (ascii / binary_little_endian) through the parser of .ply.gz inputs,
+// read in GZIP_BLOCK_SIZE blocks; faces and other elements after the vertices are ignored
+std::vector<Vec3f> get_pointcloud_from_ply(std::string ply_path)
+{
+    std::vector<Vec3f> pointcloud;
+
+    FILE* inputFile = fopen(ply_path.c_str(), "rb");
+    if(inputFile == nullptr)
+        return pointcloud;
+
+    PlyStreamParser parser;
+    std::string block(GZIP_BLOCK_SIZE, '\0');
+    size_t num_read;
+    while(!parser.failed && (num_read = fread(&block[0], 1, block.size(), inputFile)) > 0)
+        parse_ply_block(block.substr(0, num_read), parser, pointcloud);
+    fclose(inputFile);
+
+    // Last ascii vertex line without a trailing newline
+    if(!parser.binary && !parser.pending.empty())
+        parse_ply_block("\n", parser, pointcloud);
+
+    return pointcloud;
+}
+
+// Pick reader from file extension (gzip is detected from magic bytes)
+std::vector<Vec3f> get_pointcloud_from_file(std::string path)
+{
+    if(is_gzip_file(path))
+        return get_pointcloud_from_gzip(path, has_extension(path, ".ply.gz"));
+    if(has_extension(path, ".pcd"))
+        return get_pointcloud_from_pcd(path);
+    if(has_extension(path, ".bin") || has_extension(path, ".raw"))
+        return get_pointcloud_from_raw(path);
+    if(has_extension(path, ".ply"))
+        return get_pointcloud_from_ply(path);
+
+    return get_pointcloud_from_txt(path);
+}
+
+#endif
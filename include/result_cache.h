@@ -0,0 +1,204 @@
+#ifndef RESULT_CACHE
+#define RESULT_CACHE
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "include.h"
+#include "parameters.h"
+#include "runtime_parameters.h"
+#include "mapped_file.h"
+#include "pointcloud_io.h"
+
+// ===============================================================
+// Content addressed result cache
+// Finished meshes are stored in RESULT_CACHE_DIR as <hash>.<ext>, where the hash covers the
+// input file contents and every parameter that changes the output. Entries are published
+// with rename() so a reader never sees a partial file, and the least recently used entries
+// are removed once the directory grows past RESULT_CACHE_MAX_BYTES.
+
+// 64-bit hash, 8 bytes per step
+uint64_t hash_bytes(const char* data, size_t size, uint64_t seed)
+{
+    const uint64_t prime = 0x9E3779B97F4A7C15ULL;
+    uint64_t h = seed ^ (size * prime);
+
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        word *= 0xBF58476D1CE4E5B9ULL;
+        word ^= word >> 31;
+        h = (h ^ word) * prime;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, size - i);
+    h = (h ^ (tail * 0x94D049BB133111EBULL)) * prime;
+
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+// Bumped when the same parameters give different output, so older entries are not reused
+static const int RESULT_CACHE_VERSION = 2;
+
+// Everything besides the input contents that decides what the output file looks like
+std::string result_cache_parameters(const std::string &save_path)
+{
+    std::ostringstream parameters;
+    const RuntimeParameters &runtime = runtime_parameters();
+    parameters << "version=" << RESULT_CACHE_VERSION
+               << ";read_file=" << runtime.read_file
+               << ";grid_max=" << runtime.grid_max
+               << ";num_voxel=" << runtime.num_voxel
+               << ";isovalue=" << std::setprecision(9) << runtime.isovalue
+               << ";roi=" << USE_ROI;
+    if(USE_ROI)
+        parameters << "," << ROI_MIN_X << "," << ROI_MIN_Y << "," << ROI_MIN_Z
+                   << "," << ROI_MAX_X << "," << ROI_MAX_Y << "," << ROI_MAX_Z;
+    parameters << ";codec_bits=" << MESH_CODEC_FRACTION_BITS
+               << ";snap=" << SNAP_THRESHOLD
+               << ";clean=" << CLEAN_MESH << "," << WELD_TOLERANCE
+               << ";decimate=" << DECIMATE << "," << DECIMATE_TARGET_RATIO << "," << DECIMATE_MAX_ERROR
+               << ";vertex_cache=" << OPTIMIZE_VERTEX_CACHE << "," << VERTEX_CACHE_SIZE
+               << ";morton=" << MORTON_VERTEX_ORDER
+               << ";format=" << save_path.substr(extension_start(save_path));
+    return parameters.str();
+}
+
+// Empty on failure (input cannot be read)
+std::string result_cache_key(const std::string &input_path, const std::string &save_path)
+{
+    MappedFile file;
+    if(!map_file(input_path.c_str(), file))
+        return "";
+
+    uint64_t content_hash = hash_bytes(file.data, file.size, 0);
+    unmap_file(file);
+
+    std::string parameters = result_cache_parameters(save_path);
+    uint64_t key = hash_bytes(parameters.data(), parameters.size(), content_hash);
+
+    std::ostringstream hex;
+    hex << std::hex << std::setw(16) << std::setfill('0') << key;
+    return hex.str();
+}
+
+std::string result_cache_entry(const std::string &key, const std::string &save_path)
+{
+    return std::string(RESULT_CACHE_DIR) + "/" + key + save_path.substr(extension_start(save_path));
+}
+
+bool copy_file(const std::string &src_path, const std::string &dst_path)
+{
+    FILE* src = fopen(src_path.c_str(), "rb");
+    if(src == nullptr)
+        return false;
+    FILE* dst = fopen(dst_path.c_str(), "wb");
+    if(dst == nullptr)
+    {
+        fclose(src);
+        return false;
+    }
+
+    std::vector<char> buffer(1 << 20);
+    bool ok = true;
+    size_t num_read;
+    while(ok && (num_read = fread(buffer.data(), 1, buffer.size(), src)) > 0)
+        ok = fwrite(buffer.data(), 1, num_read, dst) == num_read;
+    ok = ok && !ferror(src);
+
+    fclose(src);
+    ok = (fclose(dst) == 0) && ok;
+    return ok;
+}
+
+// Copy cached output to save_path, marking the entry as recently used
+bool lookup_result_cache(const std::string &key, const std::string &save_path)
+{
+    std::string entry = result_cache_entry(key, save_path);
+
+    // Copy through a temporary so an interrupted copy never looks like finished output
+    // (per process, like publish_result_cache, so concurrent runs don't share it)
+    std::ostringstream tmp_path;
+    tmp_path << save_path << "." << getpid() << ".tmp";
+    if(!copy_file(entry, tmp_path.str()) || rename(tmp_path.str().c_str(), save_path.c_str()) != 0)
+    {
+        remove(tmp_path.str().c_str());
+        return false;
+    }
+
+    utimes(entry.c_str(), nullptr);
+    return true;
+}
+
+// Drop least recently used entries until the cache fits in RESULT_CACHE_MAX_BYTES
+void evict_result_cache()
+{
+    DIR* dir = opendir(RESULT_CACHE_DIR);
+    if(dir == nullptr)
+        return;
+
+    struct CacheEntry
+    {
+        std::string path;
+        time_t mtime;
+        uint64_t size;
+    };
+    std::vector<CacheEntry> entries;
+    uint64_t total_size = 0;
+    struct dirent* item;
+    while((item = readdir(dir)) != nullptr)
+    {
+        std::string name = item->d_name;
+        if(name == "." || name == ".." || name.find(".tmp") != std::string::npos)
+            continue;
+
+        CacheEntry entry;
+        entry.path = std::string(RESULT_CACHE_DIR) + "/" + name;
+        struct stat st;
+        if(stat(entry.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+        entry.mtime = st.st_mtime;
+        entry.size = st.st_size;
+        total_size += entry.size;
+        entries.push_back(entry);
+    }
+    closedir(dir);
+
+    std::sort(entries.begin(), entries.end(),
+              [](const CacheEntry &a, const CacheEntry &b) { return a.mtime < b.mtime; });
+    for(size_t i = 0; i < entries.size() && total_size > RESULT_CACHE_MAX_BYTES; i++)
+        if(remove(entries[i].path.c_str()) == 0)
+            total_size -= entries[i].size;
+}
+
+bool publish_result_cache(const std::string &key, const std::string &save_path)
+{
+    mkdir(RESULT_CACHE_DIR, 0755);
+
+    std::string entry = result_cache_entry(key, save_path);
+    std::ostringstream tmp_path;
+    tmp_path << entry << "." << getpid() << ".tmp";
+    if(!copy_file(save_path, tmp_path.str()) || rename(tmp_path.str().c_str(), entry.c_str()) != 0)
+    {
+        remove(tmp_path.str().c_str());
+        return false;
+    }
+
+    evict_result_cache();
+    return true;
+}
+// ===============================================================
+
+#endif
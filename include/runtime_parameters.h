@@ -0,0 +1,62 @@
+#ifndef RUNTIME_PARAMETERS
+#define RUNTIME_PARAMETERS
+
+#include <cstdlib>
+#include <string>
+
+#include "parameters.h"
+
+// ===============================================================
+// Parameters that can change without recompiling: defaults come from parameters.h and
+// command line options --read_file=0|1, --grid_max=N, --num_voxel=N and --isovalue=F
+// override them for the whole run. Set once at startup, before any thread reads them;
+// code meshing several settings in one run (sweep, daemon) passes values explicitly.
+struct RuntimeParameters
+{
+    bool read_file = READ_FILE;
+    int grid_max = GRID_MAX;
+    int num_voxel = NUM_VOXEL;
+    float isovalue = ISOVALUE;
+};
+
+RuntimeParameters &runtime_parameters()
+{
+    static RuntimeParameters parameters;
+    return parameters;
+}
+
+bool is_runtime_parameter(const std::string &arg)
+{
+    return arg.compare(0, 2, "--") == 0 && arg.find('=') != std::string::npos;
+}
+
+// One "--name=value" option; false for unknown names and malformed or out of range values
+bool parse_runtime_parameter(const std::string &arg, RuntimeParameters &parameters)
+{
+    size_t equals = arg.find('=');
+    std::string name = arg.substr(0, equals);
+    std::string value = arg.substr(equals + 1);
+    char* end;
+
+    if(name == "--isovalue")
+    {
+        parameters.isovalue = strtof(value.c_str(), &end);
+        return !value.empty() && *end == '\0';
+    }
+
+    long number = strtol(value.c_str(), &end, 10);
+    if(value.empty() || *end != '\0')
+        return false;
+    if(name == "--read_file" && (number == 0 || number == 1))
+        parameters.read_file = number;
+    else if(name == "--grid_max" && number > 0)
+        parameters.grid_max = number;
+    else if(name == "--num_voxel" && number > 0)
+        parameters.num_voxel = number;
+    else
+        return false;
+    return true;
+}
+// ===============================================================
+
+#endif
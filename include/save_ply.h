@@ -1,104 +1,144 @@
 #ifndef SAVE_PLY
 #define SAVE_PLY
 
+#include <sstream>
+#include <iomanip>
+
 #include "include.h"
+#include "async_writer.h"
+#include "shm_mesh.h"
+#include "mesh_codec.h"
+#include "parameters.h"
 // ===============================================================
+// Width of counts a writer patches in once it knows them (any size_t fits)
+static const int PLY_COUNT_WIDTH = 20;
+
+// ASCII PLY header of a mesh of xyz vertices and triangles; counts are right-aligned to
+// count_width characters, so the header length doesn't depend on them
+std::string ply_header(size_t num_vertices, size_t num_faces, int count_width = 0)
+{
+    std::ostringstream header;
+    header << "ply\n";
+    header << "format ascii 1.0\n";
+    header << "element vertex " << std::setw(count_width) << num_vertices << "\n";
+    header << "property float32 x\n";
+    header << "property float32 y\n";
+    header << "property float32 z\n";
+    header << "element face " << std::setw(count_width) << num_faces << "\n";
+    header << "property list uint8 int32 vertex_indices\n";
+    header << "end_header\n";
+    return header.str();
+}
+
 // this code following as: https://github.com/nihaljn/marching-cubes/blob/main/src/utilities.cpp
-struct Point
+// Returns number of written vertices, -1 if path can't be opened or writing fails
+int write_to_ply(const IndexedMesh &mesh, const char* path)
 {
-    float x;
-    float y;
-    float z;
+    std::ofstream outputFile;
+    outputFile.open(path);
+    if (!outputFile.is_open())
+        return -1;
+
+    outputFile << ply_header(mesh.num_vertices(), mesh.num_faces());
 
-    bool operator<(const Point& rhs) const
+    for (size_t v = 0; v < mesh.num_vertices(); v++)
+        outputFile << mesh.x[v] << " " << mesh.y[v] << " " << mesh.z[v] << "\n";
+    for (size_t f = 0; f < mesh.num_faces(); f++)
     {
-        if (x != rhs.x)
-            return x < rhs.x;
-        if (y != rhs.y)
-            return y < rhs.y;
-        return z < rhs.z;
+        outputFile << 3 << " ";
+        for (int c = 0; c < 3; c++)
+            outputFile << mesh.indices[3 * f + c] << " ";
+        outputFile << "\n";
     }
-};
 
-struct VertexContainer
-{
-    std::map<Point, int> vertexMap;
-    std::vector<std::vector<int>> triangles;
-};
+    outputFile.close();
+    if(outputFile.fail())
+        return -1;
+    return mesh.num_vertices();
+}
 
-std::vector<std::vector<Point>> triangles_to_point(std::vector<Triangle> triangles)
+// Same output as write_to_ply(), formatted into writer's buffers and written in the background
+int write_to_ply_async(const IndexedMesh &mesh, const char* path, AsyncWriter &writer)
 {
-    std::vector<std::vector<Point>> point_triangles;
-    for(int i = 0; i < triangles.size(); i++)
-    {
-        std::vector<Point> tmp;
-        for(int j = 0; j < triangles[i].vertices.size(); j++)
-        {
-            Point pt;
-            pt.x = triangles[i].vertices[j].x;
-            pt.y = triangles[i].vertices[j].y;
-            pt.z = triangles[i].vertices[j].z;
+    if (!writer.open(path))
+        return -1;
 
-            tmp.push_back(pt);
-        }
-        point_triangles.push_back(tmp);
-    }
-    return point_triangles;
-}
+    std::string header = ply_header(mesh.num_vertices(), mesh.num_faces());
+    writer.write(header.data(), header.size());
 
-VertexContainer hash_vertices_to_indices(std::vector<std::vector<Point>> &triangles)
-{
-    VertexContainer container;
-    int cnt = 0;
-    for (auto &triangle: triangles)
+    for (size_t v = 0; v < mesh.num_vertices(); v++)
+    {
+        writer.write_float(mesh.x[v]);
+        writer.write(" ");
+        writer.write_float(mesh.y[v]);
+        writer.write(" ");
+        writer.write_float(mesh.z[v]);
+        writer.write("\n");
+    }
+    for (size_t f = 0; f < mesh.num_faces(); f++)
     {
-        std::vector<int> indices;
-        for (auto &vertex: triangle)
+        writer.write("3 ");
+        for (int c = 0; c < 3; c++)
         {
-            if (container.vertexMap.count(vertex) == 0)
-            {
-                container.vertexMap[vertex] = cnt;
-                cnt++;
-            }
-            indices.push_back(container.vertexMap[vertex]);
+            writer.write_int(mesh.indices[3 * f + c]);
+            writer.write(" ");
         }
-        container.triangles.push_back(indices);
+        writer.write("\n");
     }
 
-    return container;
+    if (!writer.close())
+        return -1;
+    return mesh.num_vertices();
 }
 
-void write_to_ply(std::vector<cv::Point3f> pointcloud, std::vector<Triangle> &triangles, const char* path)
+// Place the mesh in shared memory segment `name` for a local consumer (see example/shm_consumer.cpp)
+int write_to_shm(const IndexedMesh &mesh, const std::string &name)
 {
-    std::vector<std::vector<Point>> cvt_triangles = triangles_to_point(triangles);
-    VertexContainer container = hash_vertices_to_indices(cvt_triangles);
-    
-    std::ofstream outputFile;
-    outputFile.open(path);
+    if (!write_shared_mesh(name, mesh))
+        return -1;
+    return mesh.num_vertices();
+}
 
-    outputFile << "ply\n";
-    outputFile << "format ascii 1.0\n";
-    outputFile << "element vertex " <<  container.vertexMap.size() << "\n";
-    outputFile << "property float32 x\n"; 
-    outputFile << "property float32 y\n";
-    outputFile << "property float32 z\n";
-    outputFile << "element face " << container.triangles.size() << "\n";
-    outputFile << "property list uint8 int32 vertex_indices\n";
-    outputFile << "end_header\n";
-
-    std::vector<Point> vertices (container.vertexMap.size());
-    for (auto &vertex: container.vertexMap)
-        vertices[vertex.second] = vertex.first;
-
-    for (auto &vertex: vertices)
-        outputFile << vertex.x << " " << vertex.y << " " << vertex.z << "\n";
-    for (auto &triangle: container.triangles)
-    {
-        outputFile << 3 << " ";
-        for (int index: triangle)
-            outputFile << index << " ";
-        outputFile << "\n";
-    }
+struct MeshCodecStats
+{
+    size_t raw_size;
+    size_t encoded_size;
+    double encode_ms;
+    double decode_ms;
+    float max_error;
+    bool round_trip_ok;
+};
+
+// Write compressed mesh (see mesh_codec.h) quantised on the density grid lattice,
+// then decode it again to check the round trip and measure decoding speed
+bool write_to_mtz(const IndexedMesh &mesh, const DensityGrid &grid, const char* path, MeshCodecStats &stats)
+{
+    float origin[3] = {grid.origin_x, grid.origin_y, grid.origin_z};
+    float step[3] = {grid.dx / (1 << MESH_CODEC_FRACTION_BITS),
+                     grid.dy / (1 << MESH_CODEC_FRACTION_BITS),
+                     grid.dz / (1 << MESH_CODEC_FRACTION_BITS)};
+
+    auto start_encode = std::chrono::high_resolution_clock::now();
+    std::vector<uint8_t> encoded;
+    bool ok = encode_mesh(mesh, origin, step, encoded);
+    std::chrono::duration<double, std::milli> encode_duration = std::chrono::high_resolution_clock::now() - start_encode;
+
+    auto start_decode = std::chrono::high_resolution_clock::now();
+    IndexedMesh decoded;
+    stats.round_trip_ok = ok && decode_mesh(encoded.data(), encoded.size(), decoded);
+    std::chrono::duration<double, std::milli> decode_duration = std::chrono::high_resolution_clock::now() - start_decode;
+
+    stats.raw_size = 3 * mesh.num_vertices() * sizeof(float) + mesh.indices.size() * sizeof(uint32_t);
+    stats.encoded_size = encoded.size();
+    stats.encode_ms = encode_duration.count();
+    stats.decode_ms = decode_duration.count();
+    stats.max_error = 0;
+    stats.round_trip_ok = stats.round_trip_ok && decoded.indices == mesh.indices && decoded.num_vertices() == mesh.num_vertices();
+    for (size_t v = 0; stats.round_trip_ok && v < mesh.num_vertices(); v++)
+        stats.max_error = std::max({stats.max_error, std::fabs(decoded.x[v] - mesh.x[v]),
+                                    std::fabs(decoded.y[v] - mesh.y[v]), std::fabs(decoded.z[v] - mesh.z[v])});
+
+    return ok && write_encoded_mesh(encoded, path);
 }
 
 void write_triangles_to_file(std::vector<Triangle> triangles, const char* path)
@@ -0,0 +1,142 @@
+#ifndef SHM_MESH
+#define SHM_MESH
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "indexed_mesh.h"
+
+// ===============================================================
+// Mesh handoff through a named POSIX shared memory segment
+// layout: SharedMeshHeader | float32 xyz * num_vertices | uint32 indices * 3 * num_faces
+// The producer fills everything, then sets ready = 1 (release); consumers wait for ready (acquire).
+struct SharedMeshHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t ready;
+    uint64_t num_vertices;
+    uint64_t num_faces;
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint64_t total_size;
+};
+
+static const char SHARED_MESH_MAGIC[8] = {'M', 'T', 'S', 'H', 'M', 'E', 'S', 'H'};
+static const uint32_t SHARED_MESH_VERSION = 1;
+
+struct SharedMeshView
+{
+    const SharedMeshHeader* header = nullptr;
+    const float* vertices = nullptr;
+    const uint32_t* indices = nullptr;
+    size_t size = 0;
+};
+
+bool write_shared_mesh(const std::string &name, const IndexedMesh &mesh)
+{
+    size_t num_vertices = mesh.num_vertices();
+    size_t num_faces = mesh.num_faces();
+
+    SharedMeshHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SHARED_MESH_MAGIC, sizeof(header.magic));
+    header.version = SHARED_MESH_VERSION;
+    header.num_vertices = num_vertices;
+    header.num_faces = num_faces;
+    header.vertex_offset = sizeof(header);
+    header.index_offset = header.vertex_offset + num_vertices * 3 * sizeof(float);
+    header.total_size = header.index_offset + num_faces * 3 * sizeof(uint32_t);
+
+    // Start from a fresh segment; readers still mapping an older mesh keep their copy
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0)
+        return false;
+    if(ftruncate(fd, header.total_size) != 0)
+    {
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    void* addr = mmap(nullptr, header.total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    char* segment = (char*)addr;
+    memcpy(segment, &header, sizeof(header));
+    float* vertices = (float*)(segment + header.vertex_offset);
+    for(size_t v = 0; v < num_vertices; v++)
+    {
+        vertices[3 * v] = mesh.x[v];
+        vertices[3 * v + 1] = mesh.y[v];
+        vertices[3 * v + 2] = mesh.z[v];
+    }
+    memcpy(segment + header.index_offset, mesh.indices.data(), num_faces * 3 * sizeof(uint32_t));
+
+    SharedMeshHeader* shared_header = (SharedMeshHeader*)segment;
+    __atomic_store_n(&shared_header->ready, 1u, __ATOMIC_RELEASE);
+
+    munmap(addr, header.total_size);
+    return true;
+}
+
+// Wait up to timeout_ms for the segment to exist and be ready, then map it read-only
+bool open_shared_mesh(const std::string &name, SharedMeshView &mesh, int timeout_ms)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while(true)
+    {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        struct stat st;
+        if(fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(SharedMeshHeader))
+        {
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if(addr == MAP_FAILED)
+                return false;
+
+            const SharedMeshHeader* header = (const SharedMeshHeader*)addr;
+            if(memcmp(header->magic, SHARED_MESH_MAGIC, sizeof(header->magic)) == 0 &&
+               header->version == SHARED_MESH_VERSION &&
+               __atomic_load_n(&header->ready, __ATOMIC_ACQUIRE) == 1 &&
+               header->total_size == (uint64_t)st.st_size)
+            {
+                mesh.header = header;
+                mesh.vertices = (const float*)((const char*)addr + header->vertex_offset);
+                mesh.indices = (const uint32_t*)((const char*)addr + header->index_offset);
+                mesh.size = st.st_size;
+                return true;
+            }
+            munmap(addr, st.st_size);
+        }
+        else if(fd >= 0)
+            close(fd);
+
+        if(std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void close_shared_mesh(SharedMeshView &mesh)
+{
+    if(mesh.header != nullptr)
+        munmap((void*)mesh.header, mesh.size);
+    mesh = SharedMeshView();
+}
+// ===============================================================
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef SPATIAL_INDEX
+#define SPATIAL_INDEX
+
+#include <cstring>
+#include <cstdio>
+
+#include "include.h"
+#include "parameters.h"
+#include "mapped_file.h"
+#include "pointcloud_io.h"
+
+// ===============================================================
+// Sidecar spatial index (<input>.idx), built once per input by build_index
+// layout: SpatialIndexHeader | tile table (offset, count) | points as float32 xyz sorted by tile
+// tile (ti, tj, tk) covers origin + [ti, ti + 1) * tile_size along each axis
+struct SpatialIndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    int32_t num_tiles[3];
+    float origin[3];
+    float tile_size;
+    uint64_t num_points;
+    uint64_t source_size;
+    int64_t source_mtime;
+};
+
+struct SpatialIndexTile
+{
+    uint64_t offset;
+    uint64_t count;
+};
+
+static const char SPATIAL_INDEX_MAGIC[8] = {'M', 'T', 'I', 'N', 'D', 'E', 'X', '\0'};
+static const uint32_t SPATIAL_INDEX_VERSION = 1;
+
+std::string spatial_index_path(const std::string &input_path)
+{
+    return input_path + ".idx";
+}
+
+bool build_spatial_index(const std::string &input_path, const std::string &index_path, float tile_size)
+{
+    std::vector<Vec3f> pointcloud = get_pointcloud_from_file(input_path);
+    if(pointcloud.empty() || tile_size <= 0)
+        return false;
+
+    SpatialIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SPATIAL_INDEX_MAGIC, sizeof(header.magic));
+    header.version = SPATIAL_INDEX_VERSION;
+    header.tile_size = tile_size;
+    header.num_points = pointcloud.size();
+
+    struct stat st;
+    if(stat(input_path.c_str(), &st) != 0)
+        return false;
+    header.source_size = st.st_size;
+    header.source_mtime = st.st_mtime;
+
+    float min_x, min_y, min_z, max_x, max_y, max_z;
+    find_min_pixel(pointcloud, min_x, min_y, min_z);
+    find_max_pixel(pointcloud, max_x, max_y, max_z);
+    header.origin[0] = min_x;
+    header.origin[1] = min_y;
+    header.origin[2] = min_z;
+    header.num_tiles[0] = (int)((max_x - min_x) / tile_size) + 1;
+    header.num_tiles[1] = (int)((max_y - min_y) / tile_size) + 1;
+    header.num_tiles[2] = (int)((max_z - min_z) / tile_size) + 1;
+
+    // Counting sort of points by tile
+    size_t num_tiles = (size_t)header.num_tiles[0] * header.num_tiles[1] * header.num_tiles[2];
+    std::vector<SpatialIndexTile> tiles(num_tiles);
+    std::vector<uint32_t> point_tile(pointcloud.size());
+    for(size_t t = 0; t < pointcloud.size(); t++)
+    {
+        int ti = std::min((int)((pointcloud[t].x - min_x) / tile_size), header.num_tiles[0] - 1);
+        int tj = std::min((int)((pointcloud[t].y - min_y) / tile_size), header.num_tiles[1] - 1);
+        int tk = std::min((int)((pointcloud[t].z - min_z) / tile_size), header.num_tiles[2] - 1);
+        point_tile[t] = ((size_t)tk * header.num_tiles[1] + tj) * header.num_tiles[0] + ti;
+        tiles[point_tile[t]].count++;
+    }
+    uint64_t offset = 0;
+    for(auto &tile: tiles)
+    {
+        tile.offset = offset;
+        offset += tile.count;
+    }
+
+    std::vector<float> sorted_points(3 * pointcloud.size());
+    std::vector<uint64_t> fill(num_tiles, 0);
+    for(size_t t = 0; t < pointcloud.size(); t++)
+    {
+        uint64_t dst = tiles[point_tile[t]].offset + fill[point_tile[t]]++;
+        sorted_points[3 * dst] = pointcloud[t].x;
+        sorted_points[3 * dst + 1] = pointcloud[t].y;
+        sorted_points[3 * dst + 2] = pointcloud[t].z;
+    }
+
+    std::string tmp_path = index_path + ".tmp";
+    FILE* outputFile = fopen(tmp_path.c_str(), "wb");
+    if(outputFile == nullptr)
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, outputFile) == 1 &&
+              fwrite(tiles.data(), sizeof(SpatialIndexTile), tiles.size(), outputFile) == tiles.size() &&
+              fwrite(sorted_points.data(), sizeof(float), sorted_points.size(), outputFile) == sorted_points.size();
+    ok = (fclose(outputFile) == 0) && ok;
+
+    if(!ok || rename(tmp_path.c_str(), index_path.c_str()) != 0)
+    {
+        remove(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Only tiles overlapping the box are touched, points outside the box are dropped
+bool get_pointcloud_from_index(const std::string &index_path, const std::string &input_path,
+                               float roi_min_x, float roi_min_y, float roi_min_z,
+                               float roi_max_x, float roi_max_y, float roi_max_z,
+                               std::vector<Vec3f> &pointcloud)
+{
+    MappedFile file;
+    if(!map_file(index_path.c_str(), file))
+        return false;
+
+    // Index must be newer than any change to its input
+    SpatialIndexHeader header;
+    struct stat st;
+    bool valid = file.size >= sizeof(header) && stat(input_path.c_str(), &st) == 0;
+    size_t num_tiles = 0;
+    if(valid)
+    {
+        memcpy(&header, file.data, sizeof(header));
+        num_tiles = (size_t)header.num_tiles[0] * header.num_tiles[1] * header.num_tiles[2];
+        valid = memcmp(header.magic, SPATIAL_INDEX_MAGIC, sizeof(header.magic)) == 0 &&
+                header.version == SPATIAL_INDEX_VERSION &&
+                header.source_size == (uint64_t)st.st_size &&
+                header.source_mtime == st.st_mtime &&
+                file.size == sizeof(header) + num_tiles * sizeof(SpatialIndexTile) + header.num_points * 3 * sizeof(float);
+    }
+    if(!valid)
+    {
+        unmap_file(file);
+        return false;
+    }
+
+    // Point data is read at random, don't let the kernel read ahead the whole file
+    madvise((void*)file.data, file.size, MADV_RANDOM);
+
+    const SpatialIndexTile* tiles = (const SpatialIndexTile*)(file.data + sizeof(header));
+    const float* points = (const float*)(file.data + sizeof(header) + num_tiles * sizeof(SpatialIndexTile));
+
+    float roi_min[3] = {roi_min_x, roi_min_y, roi_min_z};
+    float roi_max[3] = {roi_max_x, roi_max_y, roi_max_z};
+    int tile_begin[3], tile_end[3];
+    for(int a = 0; a < 3; a++)
+    {
+        tile_begin[a] = std::max(0, (int)std::floor((roi_min[a] - header.origin[a]) / header.tile_size));
+        tile_end[a] = std::min(header.num_tiles[a], (int)std::floor((roi_max[a] - header.origin[a]) / header.tile_size) + 1);
+    }
+
+    pointcloud.clear();
+    for(int tk = tile_begin[2]; tk < tile_end[2]; tk++)
+        for(int tj = tile_begin[1]; tj < tile_end[1]; tj++)
+            for(int ti = tile_begin[0]; ti < tile_end[0]; ti++)
+            {
+                const SpatialIndexTile &tile = tiles[((size_t)tk * header.num_tiles[1] + tj) * header.num_tiles[0] + ti];
+                for(uint64_t p = tile.offset; p < tile.offset + tile.count; p++)
+                {
+                    const float* xyz = points + 3 * p;
+                    if(xyz[0] < roi_min_x || xyz[0] > roi_max_x ||
+                       xyz[1] < roi_min_y || xyz[1] > roi_max_y ||
+                       xyz[2] < roi_min_z || xyz[2] > roi_max_z)
+                        continue;
+                    pointcloud.push_back(Vec3f(xyz[0], xyz[1], xyz[2]));
+                }
+            }
+
+    unmap_file(file);
+    return true;
+}
+
+// Region of interest read: sidecar index if present, otherwise full read + crop
+std::vector<Vec3f> get_pointcloud_in_roi(std::string path)
+{
+    std::vector<Vec3f> pointcloud;
+    if(get_pointcloud_from_index(spatial_index_path(path), path,
+                                 ROI_MIN_X, ROI_MIN_Y, ROI_MIN_Z, ROI_MAX_X, ROI_MAX_Y, ROI_MAX_Z, pointcloud))
+        return pointcloud;
+
+    std::cout << "No valid spatial index for " << path << ", reading whole file" << std::endl;
+    std::vector<Vec3f> full_pointcloud = get_pointcloud_from_file(path);
+    for(auto &pt: full_pointcloud)
+        if(pt.x >= ROI_MIN_X && pt.x <= ROI_MAX_X &&
+           pt.y >= ROI_MIN_Y && pt.y <= ROI_MAX_Y &&
+           pt.z >= ROI_MIN_Z && pt.z <= ROI_MAX_Z)
+            pointcloud.push_back(pt);
+
+    return pointcloud;
+}
+// ===============================================================
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef SWEEP
+#define SWEEP
+
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+#include "include.h"
+#include "parameters.h"
+#include "batch.h"
+
+// ===============================================================
+// Parameter sweep: the input is read once, gridded once per NUM_VOXEL value, then extracted,
+// post-processed and written for every isovalue, all with one MarchingTetrahedra
+// - meshes go next to the requested output as <OUTPUT>_v<NUM_VOXEL>_i<ISOVALUE>.<ext>
+// - one CSV row per combination (<OUTPUT> with extension .csv): times, counts, file size;
+//   grid_ms is shared by the rows of one NUM_VOXEL and left out of total_ms
+struct SweepResult
+{
+    int num_voxel;
+    float isovalue;
+
+    bool ok = false;
+    double grid_ms = 0;
+    double march_ms = 0;
+    double post_ms = 0;
+    double write_ms = 0;
+    size_t num_vertices = 0;
+    size_t num_triangles = 0;
+    uint64_t output_bytes = 0;
+};
+
+// Comma separated values, false if one doesn't parse
+template <typename Value>
+bool parse_value_list(const std::string &list, std::vector<Value> &values)
+{
+    std::istringstream items(list);
+    std::string item;
+    while(std::getline(items, item, ','))
+    {
+        std::istringstream field(item);
+        Value value;
+        if(!(field >> value) || !field.eof())
+            return false;
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+// path with suffix inserted before the extension
+std::string path_with_suffix(const std::string &path, const std::string &suffix)
+{
+    size_t dot = extension_start(path);
+    return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+// <OUTPUT> with its extension replaced by .csv
+std::string sweep_csv_path(const std::string &output_path)
+{
+    return output_path.substr(0, extension_start(output_path)) + ".csv";
+}
+
+std::string sweep_output_path(const std::string &output_path, int num_voxel, float isovalue)
+{
+    std::ostringstream suffix;
+    suffix << "_v" << num_voxel << "_i" << isovalue;
+    return path_with_suffix(output_path, suffix.str());
+}
+
+std::vector<SweepResult> run_sweep(std::vector<Vec3f> &pointcloud, const std::vector<int> &num_voxels,
+                                   const std::vector<float> &isovalues, const std::string &output_path,
+                                   MarchingTetrahedra &extractor)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    auto elapsed_ms = [](Clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    };
+
+    std::vector<SweepResult> results;
+    IndexedMesh mesh;
+    for(int num_voxel: num_voxels)
+    {
+        auto start = Clock::now();
+        DensityGrid grid = build_grid_for_pointcloud(pointcloud, num_voxel);
+        double grid_ms = elapsed_ms(start);
+
+        for(float isovalue: isovalues)
+        {
+            SweepResult result;
+            result.num_voxel = num_voxel;
+            result.isovalue = isovalue;
+            result.grid_ms = grid_ms;
+
+            start = Clock::now();
+            extractor.extract(grid, isovalue, mesh);
+            result.march_ms = elapsed_ms(start);
+
+            start = Clock::now();
+            postprocess_mesh(mesh, grid, 0);
+            result.post_ms = elapsed_ms(start);
+            result.num_vertices = mesh.num_vertices();
+            result.num_triangles = mesh.num_faces();
+
+            start = Clock::now();
+            std::string path = sweep_output_path(output_path, num_voxel, isovalue);
+            result.ok = write_mesh_file(mesh, grid, path);
+            result.write_ms = elapsed_ms(start);
+
+            struct stat st;
+            if(result.ok && stat(path.c_str(), &st) == 0)
+                result.output_bytes = st.st_size;
+            results.push_back(result);
+        }
+    }
+    return results;
+}
+
+bool write_sweep_csv(const std::string &path, const std::vector<SweepResult> &results)
+{
+    std::ofstream csv(path);
+    if(!csv)
+        return false;
+
+    csv << "num_voxel,isovalue,grid_ms,march_ms,post_ms,write_ms,total_ms,num_vertices,num_triangles,output_bytes\n";
+    for(const SweepResult &result: results)
+        csv << result.num_voxel << "," << result.isovalue << "," << result.grid_ms << "," << result.march_ms << ","
+            << result.post_ms << "," << result.write_ms << "," << result.march_ms + result.post_ms + result.write_ms << ","
+            << result.num_vertices << "," << result.num_triangles << "," << result.output_bytes << "\n";
+    return csv.good();
+}
+// ===============================================================
+
+#endif
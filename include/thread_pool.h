@@ -0,0 +1,137 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <algorithm>
+#include <vector>
+
+// Threads of a setting where 0 means every core (MARCH_THREADS, batch and daemon threads)
+inline int resolve_num_threads(int num_threads)
+{
+    return num_threads > 0 ? num_threads : (int)std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Fixed set of worker threads running submitted tasks in FIFO order
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int num_threads = 0)
+    {
+        num_threads = resolve_num_threads(num_threads);
+
+        for(int t = 0; t < num_threads; t++)
+            workers.emplace_back([this] { worker_loop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        task_ready.notify_all();
+        for(auto &worker: workers)
+            worker.join();
+    }
+
+    int size() const { return (int)workers.size(); }
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push(std::move(task));
+            pending++;
+        }
+        task_ready.notify_one();
+    }
+
+    // Block until every submitted task has finished
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        all_done.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    void worker_loop()
+    {
+        while(true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                task_ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if(tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+
+            task();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if(--pending == 0)
+                all_done.notify_all();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable task_ready;
+    std::condition_variable all_done;
+    int pending = 0;
+    bool stopping = false;
+};
+
+// Fixed capacity FIFO handing work from one thread to another
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    // Blocks while the queue is full
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this] { return items.size() < capacity; });
+        items.push(std::move(item));
+        not_empty.notify_one();
+    }
+
+    // Returns false once the queue is closed and drained
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return closed || !items.empty(); });
+        if(items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    std::queue<T> items;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    bool closed = false;
+};
+
+#endif
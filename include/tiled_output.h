@@ -0,0 +1,123 @@
+#ifndef TILED_OUTPUT_H
+#define TILED_OUTPUT_H
+
+#include <cstdio>
+
+#include "include.h"
+#include "marching_tetrahedrons.h"
+#include "mesh_cleanup.h"
+#include "save_ply.h"
+#include "pointcloud_io.h"
+#include "thread_pool.h"
+
+// ===============================================================
+// Split the grid into TILE_SIZE^3 voxel tiles, march and write each tile on its own
+// <prefix>_<ti>_<tj>_<tk>.ply per non-empty tile + <prefix>_tiles.txt manifest
+struct TileInfo
+{
+    int ti, tj, tk;
+    float min_x, min_y, min_z;
+    float max_x, max_y, max_z;
+    int num_vertices;
+    int num_triangles;
+    std::string path;
+    bool written = true;
+};
+
+std::string tile_output_prefix(const std::string &save_path)
+{
+    return save_path.substr(0, extension_start(save_path));
+}
+
+// False if the manifest can't be written
+bool write_tile_manifest(const std::vector<TileInfo> &tiles, const std::string &path)
+{
+    std::ofstream outputFile;
+    outputFile.open(path);
+    if (!outputFile.is_open())
+        return false;
+
+    outputFile << "# tile_i tile_j tile_k min_x min_y min_z max_x max_y max_z vertices triangles file\n";
+    for (auto &tile: tiles)
+    {
+        if (tile.num_triangles == 0 || !tile.written)
+            continue;
+
+        // Tile files live next to the manifest
+        std::string file_name = tile.path.substr(tile.path.find_last_of('/') + 1);
+        outputFile << tile.ti << " " << tile.tj << " " << tile.tk << " "
+                   << tile.min_x << " " << tile.min_y << " " << tile.min_z << " "
+                   << tile.max_x << " " << tile.max_y << " " << tile.max_z << " "
+                   << tile.num_vertices << " " << tile.num_triangles << " " << file_name << "\n";
+    }
+    outputFile.close();
+    return !outputFile.fail();
+}
+
+// Returns total number of triangles over all tiles; written is false if a tile or the manifest
+// failed to write (failed tiles are left out of the manifest)
+size_t write_tiled_mesh(const DensityGrid &grid, const std::string &save_path, int tile_size, ThreadPool &pool, bool &written)
+{
+    int num_cells[3] = {grid.nx - 1, grid.ny - 1, grid.nz - 1};
+    int num_tiles[3];
+    for(int a = 0; a < 3; a++)
+        num_tiles[a] = (num_cells[a] + tile_size - 1) / tile_size;
+
+    std::string prefix = tile_output_prefix(save_path);
+    std::vector<TileInfo> tiles((size_t)num_tiles[0] * num_tiles[1] * num_tiles[2]);
+    for(int tk = 0; tk < num_tiles[2]; tk++)
+        for(int tj = 0; tj < num_tiles[1]; tj++)
+            for(int ti = 0; ti < num_tiles[0]; ti++)
+            {
+                TileInfo &tile = tiles[((size_t)tk * num_tiles[1] + tj) * num_tiles[0] + ti];
+                tile.ti = ti;
+                tile.tj = tj;
+                tile.tk = tk;
+
+                // Each tile is marched and written as soon as a worker picks it up
+                pool.submit([&grid, &tile, &num_cells, &prefix, tile_size]
+                {
+                    int i_begin = tile.ti * tile_size, i_end = std::min(i_begin + tile_size, num_cells[0]);
+                    int j_begin = tile.tj * tile_size, j_end = std::min(j_begin + tile_size, num_cells[1]);
+                    int k_begin = tile.tk * tile_size, k_end = std::min(k_begin + tile_size, num_cells[2]);
+
+                    tile.min_x = grid.origin_x + i_begin * grid.dx;
+                    tile.min_y = grid.origin_y + j_begin * grid.dy;
+                    tile.min_z = grid.origin_z + k_begin * grid.dz;
+                    tile.max_x = grid.origin_x + i_end * grid.dx;
+                    tile.max_y = grid.origin_y + j_end * grid.dy;
+                    tile.max_z = grid.origin_z + k_end * grid.dz;
+
+                    IndexedMesh mesh;
+                    MeshBuilder triangles(mesh);
+                    march_cells(grid, triangles, i_begin, i_end, j_begin, j_end, k_begin, k_end);
+                    if(SNAP_THRESHOLD > 0)
+                    {
+                        FaceHashSet faceSet;
+                        remove_duplicate_faces(mesh, faceSet);
+                    }
+                    tile.num_triangles = mesh.num_faces();
+                    tile.num_vertices = 0;
+                    if(mesh.num_faces() == 0)
+                        return;
+
+                    tile.path = prefix + "_" + std::to_string(tile.ti) + "_" + std::to_string(tile.tj) + "_" + std::to_string(tile.tk) + ".ply";
+                    tile.num_vertices = write_to_ply(mesh, tile.path.c_str());
+                    tile.written = tile.num_vertices >= 0;
+                });
+            }
+    pool.wait();
+
+    written = write_tile_manifest(tiles, prefix + "_tiles.txt");
+
+    size_t total_triangles = 0;
+    for(auto &tile: tiles)
+    {
+        total_triangles += tile.num_triangles;
+        written = written && tile.written;
+    }
+    return total_triangles;
+}
+// ===============================================================
+
+#endif
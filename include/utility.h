@@ -3,6 +3,7 @@
 
 #include "include.h"
 #include "parameters.h"
+#include "runtime_parameters.h"
 
 // ===============================================================
 // For random 3D points generation
@@ -16,26 +17,26 @@ float get_random_number()
 	return randomNumber;
 }
 
-std::vector<cv::Point3f> generate_random_grid()
+std::vector<Vec3f> generate_random_grid(int grid_max)
 {
-    std::vector<cv::Point3f> scalarFunction;
+    std::vector<Vec3f> scalarFunction;
 
-	for (int i = 0; i < GRID_MAX; i++)
-		for (int j = 0; j < GRID_MAX; j++)
-            for (int k = 0; k < GRID_MAX; k++)
-                scalarFunction.push_back(cv::Point3f(i, j, k));			
+	for (int i = 0; i < grid_max; i++)
+		for (int j = 0; j < grid_max; j++)
+            for (int k = 0; k < grid_max; k++)
+                scalarFunction.push_back(Vec3f(i, j, k));			
 
 	return scalarFunction;
 }
 
-// std::map is not applied cv::Point value !! 
-PointCloud add_random_density(std::vector<cv::Point3f> pointcloud)
+// std::map is not applied Vec3f value !! 
+PointCloud add_random_density(std::vector<Vec3f> pointcloud)
 {
     PointCloud scalarFunction;
     
     for(int i = 0; i < pointcloud.size(); i++)
     {
-        cv::Point3f tmp_pt = pointcloud[i];
+        Vec3f tmp_pt = pointcloud[i];
         scalarFunction.vertices.push_back(tmp_pt);
         scalarFunction.density.push_back(-1);
     }
@@ -44,48 +45,58 @@ PointCloud add_random_density(std::vector<cv::Point3f> pointcloud)
 }
 // ===============================================================
 
-std::vector<cv::Point3f> get_pointcloud_from_txt(cv::String ply_path)
+std::vector<Vec3f> get_pointcloud_from_txt(std::string ply_path)
 {
-    std::vector<cv::Point3f> pointcloud;
+    std::vector<Vec3f> pointcloud;
 
 	float x, y, z;
 	FILE* inputFile = fopen(ply_path.c_str(), "r");
-	while (fscanf(inputFile, "%f %f %f", &x, &y, &z) != EOF)
-        pointcloud.push_back(cv::Point3f((int)x, (int)y, (int)z));
+	if (inputFile == nullptr)
+		return pointcloud;
+	while (fscanf(inputFile, "%f %f %f", &x, &y, &z) == 3)
+        pointcloud.push_back(Vec3f((int)x, (int)y, (int)z));
+	fclose(inputFile);
 
 	return pointcloud;
 }
 
-std::vector<cv::Point3f> get_pointcloud_from_ply(cv::String ply_path)
+// Incremental version of the fscanf("%f %f %f") loop above for text arriving in blocks
+// blocks must end on a token boundary, leftover values carry over to the next block
+struct TextParseState
 {
-    // Read Ply files
-    cv::viz::Mesh ply_file = cv::viz::readMesh(ply_path);
-    cv::Mat tmp_pointcloud = ply_file.cloud;
-
-    // Pointcloud size
-    int count = 0;
-    std::vector<cv::Point3f> pointcloud;
-    for(int i = 0; i < tmp_pointcloud.cols; i++)
+    float pending[3];
+    int num_pending = 0;
+    bool stopped = false;
+};
+
+void parse_text_block(const std::string &block, TextParseState &state, std::vector<Vec3f> &pointcloud)
+{
+    const char* cur = block.c_str();
+    while(!state.stopped)
     {
-        if(count == 2)
+        char* next;
+        float value = strtof(cur, &next);
+        if(next == cur)
         {
-            float x = tmp_pointcloud.at<float>(0, i-2);
-            float y = tmp_pointcloud.at<float>(0, i-1);
-            float z = tmp_pointcloud.at<float>(0, i);
-            cv::Point3f tmp_pt((int)x, (int)y, (int)z);
+            // Stop at the first token that is not a number, like fscanf
+            while(*next != '\0' && isspace((unsigned char)*next))
+                next++;
+            state.stopped = *next != '\0';
+            break;
+        }
+        cur = next;
 
-            pointcloud.push_back(tmp_pt);
-            count = 0;
-            continue;
+        state.pending[state.num_pending++] = value;
+        if(state.num_pending == 3)
+        {
+            pointcloud.push_back(Vec3f((int)state.pending[0], (int)state.pending[1], (int)state.pending[2]));
+            state.num_pending = 0;
         }
-        count++;
     }
-
-    return pointcloud;
 }
 
 // find Max pixel values to make Voxel
-void find_max_pixel(std::vector<cv::Point3f> pointcloud, float &max_x, float &max_y, float &max_z)
+void find_max_pixel(std::vector<Vec3f> pointcloud, float &max_x, float &max_y, float &max_z)
 {
     float tmp_x = pointcloud[0].x;
     float tmp_y = pointcloud[0].y;
@@ -106,7 +117,7 @@ void find_max_pixel(std::vector<cv::Point3f> pointcloud, float &max_x, float &ma
 }
 
 // find Max pixel values to make Voxel
-void find_min_pixel(std::vector<cv::Point3f> pointcloud, float &min_x, float &min_y, float &min_z)
+void find_min_pixel(std::vector<Vec3f> pointcloud, float &min_x, float &min_y, float &min_z)
 {
     float tmp_x = pointcloud[0].x;
     float tmp_y = pointcloud[0].y;
@@ -128,15 +139,52 @@ void find_min_pixel(std::vector<cv::Point3f> pointcloud, float &min_x, float &mi
 
 void cal_voxel_size(float min_x, float min_y, float min_z, 
                     float max_x, float max_y, float max_z,
-                    float &voxel_dx, float &voxel_dy, float &voxel_dz)
+                    float &voxel_dx, float &voxel_dy, float &voxel_dz, int num_voxel)
 {
     float x_diff = std::fabs(max_x - min_x);
     float y_diff = std::fabs(max_y - min_y);
     float z_diff = std::fabs(max_z - min_z);
 
-    voxel_dx = (int)(x_diff / NUM_VOXEL);
-    voxel_dy = (int)(y_diff / NUM_VOXEL);
-    voxel_dz = (int)(z_diff / NUM_VOXEL);
+    voxel_dx = (int)(x_diff / num_voxel);
+    voxel_dy = (int)(y_diff / num_voxel);
+    voxel_dz = (int)(z_diff / num_voxel);
+}
+
+// Sample densities at every voxel corner visited by the marching loop
+// (from min - voxel size up to max + voxel size), corners hit by a point get -1 and others 1
+DensityGrid build_density_grid(std::vector<Vec3f> &pointcloud,
+                               float min_x, float min_y, float min_z,
+                               float max_x, float max_y, float max_z,
+                               float voxel_dx, float voxel_dy, float voxel_dz)
+{
+    DensityGrid grid;
+    grid.dx = voxel_dx;
+    grid.dy = voxel_dy;
+    grid.dz = voxel_dz;
+    grid.origin_x = min_x - voxel_dx;
+    grid.origin_y = min_y - voxel_dy;
+    grid.origin_z = min_z - voxel_dz;
+    grid.nx = (int)((max_x - min_x) / voxel_dx) + 3;
+    grid.ny = (int)((max_y - min_y) / voxel_dy) + 3;
+    grid.nz = (int)((max_z - min_z) / voxel_dz) + 3;
+    grid.density.assign((size_t)grid.nx * grid.ny * grid.nz, 1);
+
+    for(int t = 0; t < pointcloud.size(); t++)
+    {
+        int i = (int)((pointcloud[t].x - grid.origin_x) / grid.dx);
+        int j = (int)((pointcloud[t].y - grid.origin_y) / grid.dy);
+        int k = (int)((pointcloud[t].z - grid.origin_z) / grid.dz);
+
+        // Only points lying exactly on a corner contribute
+        if(grid.origin_x + i * grid.dx != pointcloud[t].x ||
+           grid.origin_y + j * grid.dy != pointcloud[t].y ||
+           grid.origin_z + k * grid.dz != pointcloud[t].z)
+            continue;
+
+        grid.density[((size_t)k * grid.ny + j) * grid.nx + i] = -1;
+    }
+
+    return grid;
 }
 
 #endif
\ No newline at end of file
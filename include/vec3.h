@@ -0,0 +1,23 @@
+#ifndef VEC3
+#define VEC3
+
+// ===============================================================
+// 3D point of the core (pointclouds, grid corners, triangle vertices), in place of cv::Point3f
+// Same layout and member names, only the operations the core uses
+// Kept free of OpenCV so the core builds without it (viz_mesh.h is the only OpenCV user)
+struct Vec3f
+{
+    float x, y, z;
+
+    Vec3f() : x(0), y(0), z(0) {}
+    Vec3f(float x, float y, float z) : x(x), y(y), z(z) {}
+
+    Vec3f operator+(const Vec3f &other) const { return Vec3f(x + other.x, y + other.y, z + other.z); }
+    Vec3f operator-(const Vec3f &other) const { return Vec3f(x - other.x, y - other.y, z - other.z); }
+    Vec3f operator*(float scale) const { return Vec3f(x * scale, y * scale, z * scale); }
+    bool operator==(const Vec3f &other) const { return x == other.x && y == other.y && z == other.z; }
+    bool operator!=(const Vec3f &other) const { return !(*this == other); }
+};
+// ===============================================================
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef VERTEX_HASH
+#define VERTEX_HASH
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// ===============================================================
+// Flat open-addressing hash table numbering keys in insertion order, for welding vertices
+// Key and value share one slot (16 bytes for both key types below), collisions probe linearly.
+// Unlike std::map there is no node allocation per vertex and a lookup touches one or two cache
+// lines. Hash is a functor type returning the slot hash of a key.
+template <typename Key, typename Hash>
+class FlatHashMap
+{
+public:
+    // expected_size: number of distinct keys expected, the table grows if it is exceeded
+    // (0: nothing is allocated before the first insert)
+    explicit FlatHashMap(size_t expected_size = 0)
+    {
+        if(expected_size > 0)
+            reserve(expected_size);
+    }
+
+    void reserve(size_t expected_size)
+    {
+        // Load factor stays at or below 1/2
+        size_t capacity = 16;
+        while(capacity < 2 * expected_size)
+            capacity <<= 1;
+        if(capacity > slots.size())
+            rehash(capacity);
+    }
+
+    // Index of key; a new key gets index size() and inserted is set
+    int find_or_insert(const Key &key, bool &inserted)
+    {
+        if(2 * (num_entries + 1) > slots.size())
+            rehash(slots.empty() ? 16 : 2 * slots.size());
+
+        size_t mask = slots.size() - 1;
+        for(size_t s = Hash()(key) & mask; ; s = (s + 1) & mask)
+        {
+            Slot &slot = slots[s];
+            if(slot.value < 0)
+            {
+                slot.key = key;
+                slot.value = (int32_t)num_entries++;
+                inserted = true;
+                return slot.value;
+            }
+            if(slot.key == key)
+            {
+                inserted = false;
+                return slot.value;
+            }
+        }
+    }
+
+    // Index of key, -1 if it was never inserted
+    int find(const Key &key) const
+    {
+        if(slots.empty())
+            return -1;
+        size_t mask = slots.size() - 1;
+        for(size_t s = Hash()(key) & mask; ; s = (s + 1) & mask)
+        {
+            if(slots[s].value < 0)
+                return -1;
+            if(slots[s].key == key)
+                return slots[s].value;
+        }
+    }
+
+    size_t size() const { return num_entries; }
+
+    // Forget every key, keeping the slots for the next mesh
+    void clear()
+    {
+        for(auto &slot: slots)
+            slot.value = -1;
+        num_entries = 0;
+    }
+
+private:
+    struct Slot
+    {
+        Key key;
+        int32_t value;
+    };
+
+    void rehash(size_t capacity)
+    {
+        std::vector<Slot> old_slots;
+        old_slots.swap(slots);
+
+        Slot empty = Slot();
+        empty.value = -1;
+        slots.assign(capacity, empty);
+
+        size_t mask = capacity - 1;
+        for(auto &slot: old_slots)
+        {
+            if(slot.value < 0)
+                continue;
+            size_t s = Hash()(slot.key) & mask;
+            while(slots[s].value >= 0)
+                s = (s + 1) & mask;
+            slots[s] = slot;
+        }
+    }
+
+    std::vector<Slot> slots;
+    size_t num_entries = 0;
+};
+
+// Raw bits of the three float coordinates of a vertex
+struct VertexKey
+{
+    uint32_t x, y, z;
+
+    bool operator==(const VertexKey &other) const { return x == other.x && y == other.y && z == other.z; }
+};
+
+struct VertexKeyHash
+{
+    size_t operator()(const VertexKey &key) const
+    {
+        uint64_t h = ((uint64_t)key.x << 32 | key.y) * 0x9E3779B97F4A7C15ULL;
+        h ^= (uint64_t)key.z * 0xC2B2AE3D27D4EB4FULL;
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 32;
+        return (size_t)h;
+    }
+};
+
+// Welds on positions
+class VertexHashMap : public FlatHashMap<VertexKey, VertexKeyHash>
+{
+public:
+    using FlatHashMap::FlatHashMap;
+    using FlatHashMap::find_or_insert;
+
+    // Index of (x, y, z); a new vertex gets index size() and inserted is set
+    int find_or_insert(float x, float y, float z, bool &inserted)
+    {
+        VertexKey key;
+        key.x = float_bits(x);
+        key.y = float_bits(y);
+        key.z = float_bits(z);
+        return find_or_insert(key, inserted);
+    }
+
+private:
+    // -0.0f and 0.0f compare equal, so they must share a key
+    static uint32_t float_bits(float value)
+    {
+        value += 0.0f;
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+};
+
+struct EdgeKeyHash
+{
+    size_t operator()(uint64_t key) const
+    {
+        key ^= key >> 31;
+        key *= 0x9E3779B97F4A7C15ULL;
+        key ^= key >> 29;
+        return (size_t)key;
+    }
+};
+
+// Welds on exact 64-bit edge IDs (see edge_crossing() in marching_tetrahedrons.h)
+typedef FlatHashMap<uint64_t, EdgeKeyHash> EdgeHashMap;
+// ===============================================================
+
+#endif
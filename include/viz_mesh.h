@@ -6,6 +6,9 @@
 #include "opencv2/viz/viz3d.hpp"
 #include "opencv2/viz/widgets.hpp"
 
+// Visualisation is the only part using OpenCV: built on its own as ./viz_mesh (src/viz_mesh.cpp),
+// the marching core and tools don't include this header
+
 // Visualization 3D Mesh using PLY file
 void viz3DMesh(cv::String mesh_path)
 {
@@ -0,0 +1,162 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+
+#include "../include/vertex_hash.h"
+
+// Benchmark of vertex welding: std::map<Point, int> (previous hash_vertices_to_indices())
+// against the flat VertexHashMap, on a triangle soup of a wavy height field
+// grid_side^2 cells, 2 triangles per cell, 6 * grid_side^2 vertex references
+// Integer keys (like edge IDs) are also welded by EdgeHashMap
+
+struct Point
+{
+    float x;
+    float y;
+    float z;
+
+    bool operator<(const Point& rhs) const
+    {
+        if (x != rhs.x)
+            return x < rhs.x;
+        if (y != rhs.y)
+            return y < rhs.y;
+        return z < rhs.z;
+    }
+};
+
+// Integer key of every reference: height field node index * 32, like an edge ID
+std::vector<uint64_t> make_soup_keys(int grid_side)
+{
+    auto key = [grid_side](int i, int j) { return ((uint64_t)j * (grid_side + 1) + i) * 32; };
+
+    std::vector<uint64_t> keys;
+    keys.reserve((size_t)6 * grid_side * grid_side);
+    for(int j = 0; j < grid_side; j++)
+        for(int i = 0; i < grid_side; i++)
+        {
+            keys.push_back(key(i, j));
+            keys.push_back(key(i + 1, j));
+            keys.push_back(key(i + 1, j + 1));
+            keys.push_back(key(i, j));
+            keys.push_back(key(i + 1, j + 1));
+            keys.push_back(key(i, j + 1));
+        }
+    return keys;
+}
+
+std::vector<Point> make_triangle_soup(int grid_side)
+{
+    auto vertex = [](int i, int j) {
+        Point pt;
+        pt.x = i * 0.5f;
+        pt.y = j * 0.5f;
+        pt.z = 4.0f * std::sin(i * 0.01f) * std::cos(j * 0.013f);
+        return pt;
+    };
+
+    std::vector<Point> soup;
+    soup.reserve((size_t)6 * grid_side * grid_side);
+    for(int j = 0; j < grid_side; j++)
+        for(int i = 0; i < grid_side; i++)
+        {
+            soup.push_back(vertex(i, j));
+            soup.push_back(vertex(i + 1, j));
+            soup.push_back(vertex(i + 1, j + 1));
+            soup.push_back(vertex(i, j));
+            soup.push_back(vertex(i + 1, j + 1));
+            soup.push_back(vertex(i, j + 1));
+        }
+    return soup;
+}
+
+int main(int argc, char* argv[])
+{
+    int grid_side = argc > 1 ? atoi(argv[1]) : 2000;
+    if(grid_side <= 0)
+    {
+        std::cout << "Usage: ./bench_weld [GRID_SIDE]" << std::endl;
+        return 1;
+    }
+
+    std::vector<Point> soup = make_triangle_soup(grid_side);
+    size_t num_triangles = soup.size() / 3;
+    std::cout << "Vertex References: " << soup.size() << ", Triangles: " << num_triangles << std::endl;
+
+    // ===============================================================
+    // std::map, count() + operator[] as before
+    std::vector<int> map_indices(soup.size());
+    size_t map_vertices;
+    auto start_map = std::chrono::high_resolution_clock::now();
+    {
+        std::map<Point, int> vertexMap;
+        int cnt = 0;
+        for(size_t r = 0; r < soup.size(); r++)
+        {
+            if(vertexMap.count(soup[r]) == 0)
+            {
+                vertexMap[soup[r]] = cnt;
+                cnt++;
+            }
+            map_indices[r] = vertexMap[soup[r]];
+        }
+        map_vertices = vertexMap.size();
+    }
+    auto end_map = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> map_duration = end_map - start_map;
+    // ===============================================================
+
+    // ===============================================================
+    // Flat open-addressing table pre-sized from the triangle count
+    std::vector<int> hash_indices(soup.size());
+    size_t hash_vertices;
+    auto start_hash = std::chrono::high_resolution_clock::now();
+    {
+        VertexHashMap vertexMap(num_triangles);
+        for(size_t r = 0; r < soup.size(); r++)
+        {
+            bool inserted;
+            hash_indices[r] = vertexMap.find_or_insert(soup[r].x, soup[r].y, soup[r].z, inserted);
+        }
+        hash_vertices = vertexMap.size();
+    }
+    auto end_hash = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> hash_duration = end_hash - start_hash;
+    // ===============================================================
+
+    std::vector<Point>().swap(soup);
+    std::vector<uint64_t> keys = make_soup_keys(grid_side);
+
+    // ===============================================================
+    // Integer keys, flat open-addressing table
+    std::vector<int> edge_indices(keys.size());
+    auto start_edge = std::chrono::high_resolution_clock::now();
+    {
+        EdgeHashMap edgeMap(num_triangles);
+        for(size_t r = 0; r < keys.size(); r++)
+        {
+            bool inserted;
+            edge_indices[r] = edgeMap.find_or_insert(keys[r], inserted);
+        }
+    }
+    auto end_edge = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> edge_duration = end_edge - start_edge;
+    // ===============================================================
+
+    size_t num_refs = keys.size();
+    std::cout << "Unique Vertices: " << map_vertices << std::endl;
+    std::cout << "std::map Weld Time: " << map_duration.count() << " ms ("
+              << num_refs / (map_duration.count() * 1000.0) << " M refs/s)" << std::endl;
+    std::cout << "VertexHashMap Weld Time: " << hash_duration.count() << " ms ("
+              << num_refs / (hash_duration.count() * 1000.0) << " M refs/s)" << std::endl;
+    std::cout << "EdgeHashMap Weld Time: " << edge_duration.count() << " ms ("
+              << num_refs / (edge_duration.count() * 1000.0) << " M refs/s)" << std::endl;
+    std::cout << "Speedup over std::map: " << map_duration.count() / hash_duration.count() << "x / "
+              << map_duration.count() / edge_duration.count() << "x" << std::endl;
+
+    bool same = map_vertices == hash_vertices && map_indices == hash_indices && edge_indices == hash_indices;
+    std::cout << "Indices Match: " << (same ? "yes" : "NO") << std::endl;
+    return same ? 0 : 1;
+}
@@ -0,0 +1,33 @@
+#include "../include/include.h"
+#include "../include/parameters.h"
+#include "../include/spatial_index.h"
+
+// Build sidecar spatial index <input>.idx used for region of interest reads (USE_ROI = 1)
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        std::cout << "Usage: ./build_index <INPUT_FILE_LOCATION> [TILE_SIZE]" << std::endl;
+        return 1;
+    }
+
+    float tile_size = INDEX_TILE_SIZE;
+    if(argc > 2)
+        tile_size = std::atof(argv[2]);
+
+    auto start_build_index = std::chrono::high_resolution_clock::now();
+
+    std::string index_path = spatial_index_path(argv[1]);
+    if(!build_spatial_index(argv[1], index_path, tile_size))
+    {
+        std::cout << "Failed to build spatial index: " << index_path << std::endl;
+        return 1;
+    }
+
+    auto end_build_index = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> build_index_duration = end_build_index - start_build_index;
+    std::cout << "Spatial Index Build Time: " << build_index_duration.count() << " ms" << std::endl;
+    std::cout << "Saved: " << index_path << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+
+#include "../include/mesh_codec.h"
+#include "../include/save_ply.h"
+
+// Convert compressed mesh (.mtz) written by ./marching back to ASCII PLY
+int main(int argc, char* argv[])
+{
+    if(argc < 3)
+    {
+        std::cout << "Usage: ./decode_mesh <INPUT_MTZ_LOCATION> <OUTPUT_PLY_LOCATION>" << std::endl;
+        return 1;
+    }
+
+    std::vector<uint8_t> encoded;
+    if(!read_encoded_mesh(argv[1], encoded))
+    {
+        std::cout << "Failed to read: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    auto start_decode = std::chrono::high_resolution_clock::now();
+
+    IndexedMesh mesh;
+    if(!decode_mesh(encoded.data(), encoded.size(), mesh))
+    {
+        std::cout << "Invalid compressed mesh: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    auto end_decode = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> decode_duration = end_decode - start_decode;
+    std::cout << "Mesh Decode Time: " << decode_duration.count() << " ms" << std::endl;
+
+    if(write_to_ply(mesh, argv[2]) < 0)
+    {
+        std::cout << "Failed to write: " << argv[2] << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -2,86 +2,323 @@
 #include "../include/parameters.h"
 #include "../include/utility.h"
 #include "../include/marching_tetrahedrons.h"
-#include "../include/viz_mesh.h"
+#include "../include/extractor.h"
 #include "../include/save_ply.h"
+#include "../include/grid_cache.h"
+#include "../include/pointcloud_io.h"
+#include "../include/tiled_output.h"
+#include "../include/pipeline.h"
+#include "../include/spatial_index.h"
+#include "../include/result_cache.h"
+#include "../include/mesh_cleanup.h"
+#include "../include/mesh_optimize.h"
+#include "../include/mesh_decimate.h"
+#include "../include/morton_order.h"
+#include "../include/batch.h"
+#include "../include/mesh_daemon.h"
+#include "../include/sweep.h"
+#include "../include/runtime_parameters.h"
 
-int main(int argc, char* argv[])
+// Store finished output in the result cache
+void publish_result(const std::string &result_key, const std::string &save_path)
 {
-    // ===============================================================
-    // Generate Pointcloud with Random density
-    auto start_gen_pointcloud = std::chrono::high_resolution_clock::now();
+    if(result_key.empty())
+        return;
+
+    auto start_publish_result = std::chrono::high_resolution_clock::now();
+
+    if(!publish_result_cache(result_key, save_path))
+        std::cout << "Failed to publish result cache entry: " << result_cache_entry(result_key, save_path) << std::endl;
+
+    auto end_publish_result = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> publish_result_duration = end_publish_result - start_publish_result;
+    std::cout << "Result Cache Publish Time: " << publish_result_duration.count() << " ms" << std::endl;
+}
+
+// Mesh every input of a manifest on one thread pool (0 threads = every core)
+int run_batch_mode(const char* manifest_path, int num_threads)
+{
+    std::vector<BatchJob> jobs;
+    if(!read_batch_manifest(manifest_path, jobs))
+    {
+        std::cout << "Failed to read batch manifest: " << manifest_path << std::endl;
+        return 1;
+    }
+
+    ThreadPool pool(num_threads);
+    double batch_ms = run_batch(jobs, pool);
+
+    size_t num_failed = 0, num_triangles = 0;
+    double sum_job_ms = 0;
+    for(size_t j = 0; j < jobs.size(); j++)
+    {
+        const BatchJob &job = jobs[j];
+        std::cout << "Job " << j << " " << job.input_path << " -> " << job.output_path << ": ";
+        if(job.ok)
+            std::cout << job.num_triangles << " triangles, read " << job.read_ms << " / grid " << job.grid_ms << " / march "
+                      << job.march_ms << " / post " << job.post_ms << " / write " << job.write_ms << " ms, total " << job.total_ms << " ms" << std::endl;
+        else
+            std::cout << "FAILED (" << job.num_points << " points read)" << std::endl;
+        num_failed += !job.ok;
+        num_triangles += job.num_triangles;
+        sum_job_ms += job.total_ms;
+    }
+
+    std::cout << "Batch Jobs: " << jobs.size() << " (" << num_failed << " failed), Threads: " << pool.size() << std::endl;
+    std::cout << "Number of triangles: " << num_triangles << std::endl;
+    std::cout << "Sum of Job Times: " << sum_job_ms << " ms" << std::endl;
+    std::cout << "Batch Total Time: " << batch_ms << " ms (" << jobs.size() / (batch_ms / 1000.0) << " jobs/s)" << std::endl;
+    return num_failed == 0 ? 0 : 1;
+}
 
-    std::vector<cv::Point3f> pointcloud = generate_random_grid();
-    PointCloud pointcloud_with_density;
-    if(READ_FILE)
+// Serve meshing jobs on a UNIX socket until a SHUTDOWN request (0 threads = every core)
+int run_daemon_mode(const char* socket_path, int num_threads)
+{
+    MeshDaemon daemon(socket_path, num_threads);
+    if(!daemon.start())
+    {
+        std::cout << "Failed to listen on: " << socket_path << " (path must be free or a stale socket)" << std::endl;
+        return 1;
+    }
+    std::cout << "Listening on " << socket_path << " (" << daemon.num_threads() << " threads)" << std::endl;
+
+    size_t num_jobs = daemon.run();
+    std::cout << "Jobs Served: " << num_jobs << std::endl;
+    return 0;
+}
+
+// Read input once, mesh it for every NUM_VOXEL x ISOVALUE combination
+int run_sweep_mode(const char* input_path, const std::string &output_path, const char* num_voxel_list, const char* isovalue_list)
+{
+    std::vector<int> num_voxels;
+    std::vector<float> isovalues;
+    if(!parse_value_list(num_voxel_list, num_voxels) || !parse_value_list(isovalue_list, isovalues))
     {
-        cv::String ply_path = argv[1];
-        pointcloud = get_pointcloud_from_txt(ply_path);
+        std::cout << "Invalid value list: " << num_voxel_list << " / " << isovalue_list << std::endl;
+        return 1;
     }
-    pointcloud_with_density = add_random_density(pointcloud);
+    for(int num_voxel: num_voxels)
+        if(num_voxel <= 0)
+        {
+            std::cout << "Invalid NUM_VOXEL: " << num_voxel << std::endl;
+            return 1;
+        }
+
+    auto start_read = std::chrono::high_resolution_clock::now();
+
+    std::vector<Vec3f> pointcloud = get_pointcloud_from_file(input_path);
+    if(pointcloud.empty())
+    {
+        std::cout << "Failed to read pointcloud: " << input_path << std::endl;
+        return 1;
+    }
+
+    auto end_read = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> read_duration = end_read - start_read;
     std::cout << "Number of pointcloud: " << pointcloud.size() << std::endl;
+    std::cout << "Pointcloud Read Time: " << read_duration.count() << " ms" << std::endl;
 
-    auto end_gen_pointcloud = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double, std::milli> gen_pointcloud_duration = end_gen_pointcloud - start_gen_pointcloud;
-    std::cout << "Pointcloud Generation Time: " << gen_pointcloud_duration.count() << " ms" << std::endl;
+    MarchingTetrahedra extractor;
+    std::vector<SweepResult> results = run_sweep(pointcloud, num_voxels, isovalues, output_path, extractor);
+
+    size_t num_failed = 0;
+    for(const SweepResult &result: results)
+    {
+        std::cout << "NUM_VOXEL " << result.num_voxel << ", ISOVALUE " << result.isovalue << ": ";
+        if(result.ok)
+            std::cout << result.num_triangles << " triangles, " << result.output_bytes << " bytes, march " << result.march_ms
+                      << " / post " << result.post_ms << " / write " << result.write_ms << " ms" << std::endl;
+        else
+            std::cout << "FAILED to write " << sweep_output_path(output_path, result.num_voxel, result.isovalue) << std::endl;
+        num_failed += !result.ok;
+    }
+
+    std::string csv_path = sweep_csv_path(output_path);
+    if(!write_sweep_csv(csv_path, results))
+    {
+        std::cout << "Failed to write: " << csv_path << std::endl;
+        return 1;
+    }
+    std::cout << "Sweep Results: " << csv_path << std::endl;
+    return num_failed == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    // ===============================================================
+    // Runtime parameters (--num_voxel=200, ...) override parameters.h, the other arguments stay positional
+    std::vector<char*> args;
+    for(int a = 0; a < argc; a++)
+    {
+        if(!is_runtime_parameter(argv[a]))
+            args.push_back(argv[a]);
+        else if(!parse_runtime_parameter(argv[a], runtime_parameters()))
+        {
+            std::cout << "Invalid option: " << argv[a] << " (--read_file=0|1, --grid_max=N, --num_voxel=N, --isovalue=F)" << std::endl;
+            return 1;
+        }
+    }
+    argc = args.size();
+    argv = args.data();
+    const RuntimeParameters &params = runtime_parameters();
     // ===============================================================
 
     // ===============================================================
-    // Calculate Voxel Size
-    auto start_cal_voxel_size = std::chrono::high_resolution_clock::now();
+    // Batch mode: ./marching --batch <MANIFEST> [NUM_THREADS]
+    if(argc >= 3 && std::string(argv[1]) == "--batch")
+        return run_batch_mode(argv[2], argc > 3 ? atoi(argv[3]) : 0);
+    // Daemon mode: ./marching --serve <SOCKET_PATH> [NUM_THREADS]
+    if(argc >= 3 && std::string(argv[1]) == "--serve")
+        return run_daemon_mode(argv[2], argc > 3 ? atoi(argv[3]) : 0);
+    // Sweep mode: ./marching --sweep <INPUT> <OUTPUT> <NUM_VOXEL,...> <ISOVALUE,...>
+    if(argc >= 6 && std::string(argv[1]) == "--sweep")
+        return run_sweep_mode(argv[2], argv[3], argv[4], argv[5]);
+    // ===============================================================
 
-    float min_x, min_y, min_z;
-    find_min_pixel(pointcloud, min_x, min_y, min_z);
-    float max_x, max_y, max_z;
-    find_max_pixel(pointcloud, max_x, max_y, max_z);
-    
-    float voxel_dx = 1;
-    float voxel_dy = 1;
-    float voxel_dz = 1;
-    if(READ_FILE)
-        cal_voxel_size(min_x, min_y, min_z, max_x, max_y, max_z, voxel_dx, voxel_dy, voxel_dz);
+    // ===============================================================
+    // Result cache: same input contents and parameters were meshed before
+    std::string result_key;
+    if(params.read_file && USE_RESULT_CACHE && !TILED_OUTPUT && !SHM_OUTPUT && !BUILD_MESHLETS)
+    {
+        auto start_result_cache = std::chrono::high_resolution_clock::now();
 
-    if(voxel_dx == 0)
-        voxel_dx = 1;
-    if(voxel_dy == 0)
-        voxel_dy = 1;
-    if(voxel_dz == 0)
-        voxel_dz = 1;
+        result_key = result_cache_key(argv[1], argv[2]);
+        bool result_cache_hit = !result_key.empty() && lookup_result_cache(result_key, argv[2]);
 
-    auto end_cal_voxel_size = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double, std::milli> cal_voxel_size_duration = end_cal_voxel_size - start_cal_voxel_size;
-    std::cout << "Voxel Size Calculation Time: " << cal_voxel_size_duration.count() << " ms" << std::endl;
+        auto end_result_cache = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> result_cache_duration = end_result_cache - start_result_cache;
+        std::cout << "Result Cache " << (result_cache_hit ? "Hit" : "Miss") << ": " << result_cache_duration.count() << " ms" << std::endl;
+        if(result_cache_hit)
+            return 0;
+    }
     // ===============================================================
 
     // ===============================================================
-    // Marching Cubes
-    auto start_marching_cubes = std::chrono::high_resolution_clock::now();
+    // Pipelined execution: every stage overlaps with the others
+    if(params.read_file && PIPELINE_MODE)
+    {
+        PipelineTimes times;
+        size_t num_triangles = run_pipeline(argv[1], argv[2], times);
+
+        std::cout << "Pointcloud Read Time: " << times.read_ms << " ms" << std::endl;
+        std::cout << "Pointcloud Parse Time: " << times.parse_ms << " ms" << std::endl;
+        std::cout << "Voxel Size Calculation Time: " << times.voxel_size_ms << " ms" << std::endl;
+        std::cout << "Density Grid Construction Time: " << times.grid_ms << " ms" << std::endl;
+        std::cout << "Marching Tetrahedrons Time: " << times.march_ms << " ms" << std::endl;
+        std::cout << "Write PLY Time: " << times.write_ms << " ms" << std::endl;
+        std::cout << "Number of triangles: " << num_triangles << std::endl;
+        std::cout << "Pipeline Total Time: " << times.total_ms << " ms" << std::endl;
 
-    std::vector<Triangle> triangles;
-    for (float z = min_z - voxel_dz; z <= max_z; z += voxel_dz)
+        if(!times.written)
+        {
+            std::cout << "Failed to read " << argv[1] << " or write " << argv[2] << std::endl;
+            return 1;
+        }
+        publish_result(result_key, argv[2]);
+        return 0;
+    }
+    // ===============================================================
+
+    // ===============================================================
+    // Load Density Grid from cache (skips reading, voxel size and grid construction)
+    DensityGrid grid;
+    bool grid_cache_hit = false;
+    if(params.read_file && USE_GRID_CACHE && !USE_ROI)
+    {
+        auto start_load_grid_cache = std::chrono::high_resolution_clock::now();
+
+        grid_cache_hit = load_grid_cache(grid_cache_path(argv[1]), argv[1], grid);
+
+        auto end_load_grid_cache = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> load_grid_cache_duration = end_load_grid_cache - start_load_grid_cache;
+        std::cout << "Grid Cache " << (grid_cache_hit ? "Hit" : "Miss") << ": " << load_grid_cache_duration.count() << " ms" << std::endl;
+    }
+    // ===============================================================
+
+    std::vector<Vec3f> pointcloud;
+    if(!grid_cache_hit)
     {
-        for (float y = min_y - voxel_dy; y <= max_y; y += voxel_dy)
+        // ===============================================================
+        // Generate Pointcloud with Random density
+        auto start_gen_pointcloud = std::chrono::high_resolution_clock::now();
+
+        if(params.read_file)
+        {
+            std::string ply_path = argv[1];
+            if(USE_ROI)
+                pointcloud = get_pointcloud_in_roi(ply_path);
+            else
+                pointcloud = get_pointcloud_from_file(ply_path);
+        }
+        else
+            pointcloud = generate_random_grid(params.grid_max);
+        std::cout << "Number of pointcloud: " << pointcloud.size() << std::endl;
+        if(pointcloud.empty())
         {
-            for (float x = min_x - voxel_dx; x <= max_x; x += voxel_dx)
-            {
-                Voxel cur_voxel;
+            std::cout << "Failed to read pointcloud: " << argv[1] << std::endl;
+            return 1;
+        }
+
+        auto end_gen_pointcloud = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> gen_pointcloud_duration = end_gen_pointcloud - start_gen_pointcloud;
+        std::cout << "Pointcloud Generation Time: " << gen_pointcloud_duration.count() << " ms" << std::endl;
+        // ===============================================================
+
+        // ===============================================================
+        // Calculate Voxel Size
+        auto start_cal_voxel_size = std::chrono::high_resolution_clock::now();
 
-                // Initialize Voxel Info
-                init_voxel_vertices(pointcloud_with_density, cur_voxel, x, y, z, voxel_dx, voxel_dy, voxel_dz);
+        GridBounds bounds = grid_bounds_for_pointcloud(pointcloud, params.read_file ? params.num_voxel : 0);
 
-                // Calculate six triangles 
-                std::vector<Tetrahedron> cur_six_tetrahedrons;
-                divide_into_six_triangles(cur_voxel, cur_six_tetrahedrons);
+        auto end_cal_voxel_size = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> cal_voxel_size_duration = end_cal_voxel_size - start_cal_voxel_size;
+        std::cout << "Voxel Size Calculation Time: " << cal_voxel_size_duration.count() << " ms" << std::endl;
+        // ===============================================================
 
-                // Get six edges rule
-                std::vector<std::array<int, 6>> cur_six_edges_rule;
-                get_vertice_density(cur_six_tetrahedrons, cur_six_edges_rule);
+        // ===============================================================
+        // Build Density Grid
+        auto start_build_grid = std::chrono::high_resolution_clock::now();
 
-                // Make triangles
-                make_triangle(triangles, cur_six_tetrahedrons, cur_six_edges_rule);
-            }
+        grid = build_grid_in_bounds(pointcloud, bounds);
+        if(params.read_file && USE_GRID_CACHE && !USE_ROI && !save_grid_cache(grid_cache_path(argv[1]), argv[1], grid))
+            std::cout << "Failed to save grid cache: " << grid_cache_path(argv[1]) << std::endl;
+
+        auto end_build_grid = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> build_grid_duration = end_build_grid - start_build_grid;
+        std::cout << "Density Grid Construction Time: " << build_grid_duration.count() << " ms" << std::endl;
+        // ===============================================================
+    }
+
+    // ===============================================================
+    // Tiled output: march and write each tile concurrently
+    if(TILED_OUTPUT)
+    {
+        auto start_tiled_output = std::chrono::high_resolution_clock::now();
+
+        ThreadPool pool;
+        bool written;
+        size_t num_triangles = write_tiled_mesh(grid, argv[2], TILE_SIZE, pool, written);
+
+        auto end_tiled_output = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> tiled_output_duration = end_tiled_output - start_tiled_output;
+        std::cout << "Number of triangles: " << num_triangles << std::endl;
+        std::cout << "Tiled Marching and Writing Time (" << pool.size() << " threads): " << tiled_output_duration.count() << " ms" << std::endl;
+        if(!written)
+        {
+            std::cout << "Failed to write: " << argv[2] << std::endl;
+            return 1;
         }
+        return 0;
     }
+    // ===============================================================
+
+    // ===============================================================
+    // Marching Cubes
+    auto start_marching_cubes = std::chrono::high_resolution_clock::now();
+
+    IndexedMesh mesh;
+    MarchingTetrahedra extractor;
+    extractor.extract(grid, params.isovalue, mesh);
 
     auto end_marching_cubes = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double, std::milli> marching_cubes_duration = end_marching_cubes - start_marching_cubes;
@@ -89,11 +326,105 @@ int main(int argc, char* argv[])
     // ===============================================================
 
     // ===============================================================
-    // Write PLY file using Triangles
-    std::cout << "Number of triangles: " << triangles.size() << std::endl;
-    cv::String save_path = argv[2];
-    write_to_ply(pointcloud, triangles, save_path.c_str());
+    // Cleanup, quadric error decimation, vertex cache optimisation, Morton vertex order and meshlets
+    PostprocessReport post;
+    postprocess_mesh(mesh, grid, 0, &post);
+    if(CLEAN_MESH)
+    {
+        std::cout << "Welded Vertices: " << post.cleanup.welded_vertices << ", Removed Faces: " << post.cleanup.collapsed_faces << " collapsed / "
+                  << post.cleanup.zero_area_faces << " zero area / " << post.cleanup.duplicate_faces << " duplicate" << std::endl;
+        std::cout << "Mesh Cleanup Time: " << post.clean_ms << " ms" << std::endl;
+    }
+    if(DECIMATE)
+    {
+        std::cout << "Decimated Faces: " << post.faces_before_decimation << " -> " << mesh.num_faces()
+                  << " (" << post.decimation.collapses << " collapses, " << post.decimation.rejected << " rejected, max error "
+                  << std::sqrt(post.decimation.max_error) << ")" << std::endl;
+        std::cout << "Decimation Time: " << post.decimate_ms << " ms" << std::endl;
+    }
+    if(OPTIMIZE_VERTEX_CACHE)
+    {
+        std::cout << "ACMR (FIFO " << VERTEX_CACHE_SIZE << "): " << post.acmr_before << " -> " << post.acmr_after << std::endl;
+        std::cout << "Vertex Cache Optimisation Time: " << post.optimize_ms << " ms" << std::endl;
+    }
+    if(MORTON_VERTEX_ORDER)
+    {
+        std::cout << "Mean Face Index Distance: " << post.index_distance_before << " -> " << post.index_distance_after << std::endl;
+        std::cout << "Morton Vertex Order Time (" << post.morton_threads << " threads): " << post.morton_ms << " ms" << std::endl;
+    }
+    if(BUILD_MESHLETS)
+    {
+        auto start_meshlets = std::chrono::high_resolution_clock::now();
+
+        MeshletSet meshlets;
+        build_meshlets(mesh, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES, meshlets);
+        std::string meshlet_path = std::string(argv[2]) + ".meshlets";
+        if(!write_meshlets(meshlet_path, meshlets))
+            std::cout << "Failed to write: " << meshlet_path << std::endl;
+
+        auto end_meshlets = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> meshlets_duration = end_meshlets - start_meshlets;
+        size_t num_meshlets = std::max<size_t>(meshlets.meshlets.size(), 1);
+        std::cout << "Number of meshlets: " << meshlets.meshlets.size() << " (avg " << (double)meshlets.vertices.size() / num_meshlets
+                  << " vertices, " << (double)meshlets.triangles.size() / 3 / num_meshlets << " triangles)" << std::endl;
+        std::cout << "Meshlet Build Time: " << meshlets_duration.count() << " ms" << std::endl;
+    }
     // ===============================================================
+
+    // ===============================================================
+    // Write PLY file using the indexed mesh
+    auto start_write_ply = std::chrono::high_resolution_clock::now();
+
+    std::cout << "Number of triangles: " << mesh.num_faces() << std::endl;
+    std::string save_path = argv[2];
+    bool written = true;
+    if(SHM_OUTPUT)
+    {
+        written = write_to_shm(mesh, SHM_NAME) >= 0;
+        if(!written)
+            std::cout << "Failed to create shared memory: " << SHM_NAME << std::endl;
+        else
+            std::cout << "Mesh ready in shared memory: " << SHM_NAME << std::endl;
+    }
+    else if(has_extension(save_path, ".mtz"))
+    {
+        MeshCodecStats stats;
+        written = write_to_mtz(mesh, grid, save_path.c_str(), stats);
+        if(!written)
+            std::cout << "Failed to write: " << save_path << std::endl;
+        double raw_mb = stats.raw_size / (1024.0 * 1024.0);
+        std::cout << "Compressed Mesh Size: " << stats.encoded_size << " bytes (binary " << stats.raw_size << " bytes, ratio "
+                  << (double)stats.raw_size / std::max<size_t>(stats.encoded_size, 1) << ")" << std::endl;
+        std::cout << "Mesh Encode Time: " << stats.encode_ms << " ms (" << raw_mb / (stats.encode_ms / 1000.0) << " MB/s)" << std::endl;
+        std::cout << "Mesh Decode Time: " << stats.decode_ms << " ms (" << raw_mb / (stats.decode_ms / 1000.0) << " MB/s)" << std::endl;
+        std::cout << "Round Trip: " << (stats.round_trip_ok ? "ok" : "FAILED") << ", max position error " << stats.max_error << std::endl;
+    }
+    else if(ASYNC_WRITE)
+    {
+        AsyncWriter writer;
+        written = write_to_ply_async(mesh, save_path.c_str(), writer) >= 0;
+        if(!written)
+            std::cout << "Failed to write: " << save_path << std::endl;
+        std::cout << "Async Write Backend: " << (writer.uses_io_uring ? "io_uring" : "pwrite threads") << std::endl;
+        std::cout << "Blocked on I/O Time: " << writer.blocked_ms << " ms" << std::endl;
+    }
+    else
+    {
+        written = write_to_ply(mesh, save_path.c_str()) >= 0;
+        if(!written)
+            std::cout << "Failed to write: " << save_path << std::endl;
+    }
+
+    auto end_write_ply = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> write_ply_duration = end_write_ply - start_write_ply;
+    std::cout << "Write PLY Time: " << write_ply_duration.count() << " ms" << std::endl;
+    // ===============================================================
+
+    // A partial or stale file must never become a cache entry
+    if(!written)
+        return 1;
+    if(!SHM_OUTPUT)
+        publish_result(result_key, save_path);
     
     return 0;
 }
\ No newline at end of file
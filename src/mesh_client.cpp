@@ -0,0 +1,122 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <cstdio>
+
+#include "../include/daemon_protocol.h"
+#include "../include/indexed_mesh.h"
+#include "../include/save_ply.h"
+
+// Minimal client of the meshing daemon (./marching --serve <SOCKET_PATH>)
+//   mesh:     the daemon reads INPUT and writes OUTPUT itself
+//   points:   points of a "x y z" text file are sent inline, the mesh comes back in the reply
+//             and is written here as ASCII PLY
+//   shutdown: stops the daemon
+int main(int argc, char* argv[])
+{
+    std::string command = argc > 2 ? argv[2] : "";
+    if(!((command == "mesh" || command == "points") && argc >= 5) && command != "shutdown")
+    {
+        std::cout << "Usage: ./mesh_client <SOCKET_PATH> mesh <INPUT_FILE_LOCATION> <OUTPUT_SAVE_LOCATION> [ISOVALUE [NUM_VOXEL]]" << std::endl;
+        std::cout << "       ./mesh_client <SOCKET_PATH> points <INPUT_TXT_LOCATION> <OUTPUT_PLY_LOCATION> [ISOVALUE [NUM_VOXEL]]" << std::endl;
+        std::cout << "       ./mesh_client <SOCKET_PATH> shutdown" << std::endl;
+        return 1;
+    }
+
+    std::vector<float> points;
+    if(command == "points")
+    {
+        float x, y, z;
+        FILE* inputFile = fopen(argv[3], "r");
+        if(inputFile == nullptr)
+        {
+            std::cout << "Failed to read: " << argv[3] << std::endl;
+            return 1;
+        }
+        while(fscanf(inputFile, "%f %f %f", &x, &y, &z) == 3)
+            points.insert(points.end(), {x, y, z});
+        fclose(inputFile);
+    }
+
+    auto start_request = std::chrono::high_resolution_clock::now();
+
+    int fd = connect_to_daemon(argv[1]);
+    if(fd < 0)
+    {
+        std::cout << "Failed to connect: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::string request;
+    if(command == "mesh")
+        request = std::string("MESH ") + argv[3] + " " + argv[4];
+    else if(command == "points")
+        request = "POINTS " + std::to_string(points.size() / 3) + " -";
+    else
+        request = "SHUTDOWN";
+    for(int a = 5; a < argc && a < 7; a++)
+        request += std::string(" ") + argv[a];
+
+    std::string reply;
+    if(!write_line(fd, request) || !write_all(fd, points.data(), points.size() * sizeof(float)) || !read_line(fd, reply))
+    {
+        std::cout << "Connection lost" << std::endl;
+        close(fd);
+        return 1;
+    }
+
+    std::istringstream fields(reply);
+    std::string status;
+    size_t num_vertices = 0, num_faces = 0;
+    double job_ms = 0;
+    fields >> status >> num_vertices >> num_faces >> job_ms;
+    if(status != "OK")
+    {
+        std::cout << reply << std::endl;
+        close(fd);
+        return 1;
+    }
+
+    if(command == "shutdown")
+    {
+        std::cout << "Daemon Stopped" << std::endl;
+        close(fd);
+        return 0;
+    }
+
+    IndexedMesh mesh;
+    if(command == "points")
+    {
+        std::vector<float> xyz(3 * num_vertices);
+        mesh.indices.resize(3 * num_faces);
+        if(!read_all(fd, xyz.data(), xyz.size() * sizeof(float)) ||
+           !read_all(fd, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t)))
+        {
+            std::cout << "Connection lost" << std::endl;
+            close(fd);
+            return 1;
+        }
+        for(size_t v = 0; v < num_vertices; v++)
+        {
+            mesh.x.push_back(xyz[3 * v]);
+            mesh.y.push_back(xyz[3 * v + 1]);
+            mesh.z.push_back(xyz[3 * v + 2]);
+        }
+    }
+    close(fd);
+
+    auto end_request = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> request_duration = end_request - start_request;
+    std::cout << "Number of triangles: " << num_faces << std::endl;
+    std::cout << "Daemon Job Time: " << job_ms << " ms" << std::endl;
+    std::cout << "Request Round Trip Time: " << request_duration.count() << " ms" << std::endl;
+
+    if(command == "points" && write_to_ply(mesh, argv[4]) < 0)
+    {
+        std::cout << "Failed to write: " << argv[4] << std::endl;
+        return 1;
+    }
+    return 0;
+}
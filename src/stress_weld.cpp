@@ -0,0 +1,103 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <algorithm>
+
+#include "../include/concurrent_weld.h"
+#include "../include/thread_pool.h"
+
+// Stress test of ConcurrentEdgeMap: every thread inserts the same NUM_KEYS edge-ID-like keys,
+// each in its own shuffled order, so most inserts race with another thread on the same key.
+// A round passes if all threads got the same index for every key, exactly one thread inserted
+// each key and the indices are a permutation of [0, NUM_KEYS).
+
+// Sparse keys like edge IDs: node index * 32 + direction
+std::vector<uint64_t> make_keys(size_t num_keys)
+{
+    std::vector<uint64_t> keys(num_keys);
+    for(size_t n = 0; n < num_keys; n++)
+        keys[n] = (uint64_t)(n * 7 / 4) * 32 + 13 + n % 14;
+    return keys;
+}
+
+bool run_round(const std::vector<uint64_t> &keys, ThreadPool &pool, int round)
+{
+    size_t num_keys = keys.size();
+    int num_threads = pool.size();
+
+    ConcurrentEdgeMap edgeMap(num_keys);
+    std::vector<std::vector<int>> thread_indices(num_threads, std::vector<int>(num_keys));
+    std::vector<std::vector<char>> thread_inserted(num_threads, std::vector<char>(num_keys));
+    for(int t = 0; t < num_threads; t++)
+        pool.submit([&, t] {
+            std::vector<uint32_t> order(num_keys);
+            for(size_t n = 0; n < num_keys; n++)
+                order[n] = n;
+            std::mt19937 rng(round * 1000 + t);
+            std::shuffle(order.begin(), order.end(), rng);
+
+            for(uint32_t n: order)
+            {
+                bool inserted;
+                thread_indices[t][n] = edgeMap.find_or_insert(keys[n], inserted);
+                thread_inserted[t][n] = inserted;
+            }
+        });
+    pool.wait();
+
+    if(edgeMap.size() != num_keys)
+        return false;
+
+    std::vector<char> index_used(num_keys, 0);
+    for(size_t n = 0; n < num_keys; n++)
+    {
+        int index = thread_indices[0][n];
+        if(index < 0 || (size_t)index >= num_keys || index_used[index])
+            return false;
+        index_used[index] = 1;
+
+        int inserts = 0;
+        for(int t = 0; t < num_threads; t++)
+        {
+            if(thread_indices[t][n] != index)
+                return false;
+            inserts += thread_inserted[t][n];
+        }
+        if(inserts != 1)
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t num_keys = argc > 1 ? atol(argv[1]) : 1000000;
+    int num_threads = argc > 2 ? atoi(argv[2]) : 8;
+    int num_rounds = argc > 3 ? atoi(argv[3]) : 10;
+    if(num_keys == 0 || num_threads <= 0 || num_rounds <= 0)
+    {
+        std::cout << "Usage: ./stress_weld [NUM_KEYS] [NUM_THREADS] [NUM_ROUNDS]" << std::endl;
+        return 1;
+    }
+
+    std::vector<uint64_t> keys = make_keys(num_keys);
+    ThreadPool pool(num_threads);
+    std::cout << "Keys: " << num_keys << ", Threads: " << pool.size() << ", Rounds: " << num_rounds << std::endl;
+
+    int failed = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int round = 0; round < num_rounds; round++)
+        if(!run_round(keys, pool, round))
+        {
+            std::cout << "Round " << round << ": indices NOT unique" << std::endl;
+            failed++;
+        }
+    std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+
+    double num_inserts = (double)num_keys * pool.size() * num_rounds;
+    std::cout << "Concurrent Weld Time: " << duration.count() << " ms ("
+              << num_inserts / (duration.count() * 1000.0) << " M inserts/s)" << std::endl;
+    std::cout << "Indices Unique: " << (failed == 0 ? "yes" : "NO") << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+#include <iostream>
+#include <string>
+
+#include "../include/viz_mesh.h"
+
+// Optional viewer, the only OpenCV (viz) target: shows a PLY written by ./marching as a mesh,
+// or its vertices as a pointcloud
+int main(int argc, char* argv[])
+{
+    std::string mode = argc > 2 ? argv[2] : "mesh";
+    if(argc < 2 || (mode != "mesh" && mode != "points"))
+    {
+        std::cout << "Usage: ./viz_mesh <PLY_LOCATION> [mesh|points]" << std::endl;
+        return 1;
+    }
+
+    if(mode == "mesh")
+        viz3DMesh(argv[1]);
+    else
+        viz3DPoints(argv[1]);
+    return 0;
+}
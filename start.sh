@@ -1,2 +1,10 @@
-g++ ./src/main.cpp -L /usr/local/include/opencv2 -lopencv_viz -lopencv_highgui -lopencv_imgcodecs -lopencv_imgproc -lopencv_core -lopencv_features2d -o ./marching
+g++ ./src/main.cpp -pthread -lz -lrt -o ./marching
+g++ ./src/build_index.cpp -pthread -lz -lrt -o ./build_index
+g++ ./example/shm_consumer.cpp -pthread -lz -lrt -o ./shm_consumer
+g++ ./src/decode_mesh.cpp -pthread -lz -lrt -o ./decode_mesh
+g++ -O2 ./src/bench_weld.cpp -pthread -o ./bench_weld
+g++ -O2 ./src/stress_weld.cpp -pthread -o ./stress_weld
+g++ -O2 ./src/mesh_client.cpp -pthread -lz -lrt -o ./mesh_client
+# Optional viewer, the only target needing OpenCV (viz)
+# g++ ./src/viz_mesh.cpp -L /usr/local/include/opencv2 -lopencv_viz -lopencv_core -o ./viz_mesh
 ./marching "./example/input/sphere.txt" "./example/output/marching_cubes.ply"
\ No newline at end of file